@@ -1,15 +1,23 @@
 #include "Export.h"
 #include "data/Model.h"
 #include "geometry/PrefabMesher.h"
+#include "geometry/LODMesher.h"
+#include "geometry/ExteriorShell.h"
+#include "geometry/MeshOptimizer.h"
+#include "geometry/MeshletBuilder.h"
+#include "util/Parallel.h"
 #include "parse/HytalePrefabParser.h"
 #include "output/OBJExporter.h"
+#include "output/MeshletWriter.h"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 
 Export::Export(ExportConfig* config) : config(config) {}
 
 void Export::exportPrefab()
 {
-    TextureRegistry textureRegistry(512, 512, 32);
+    TextureRegistry textureRegistry(config->maxAtlasSize, 32, config->atlasGutter);
     ModelRegistry blockModelRegistry(config->assetsPath, &textureRegistry);
 
     auto prefab = PrefabLoader::loadFromFile(config->prefabPath);
@@ -21,18 +29,17 @@ void Export::exportPrefab()
     std::unordered_set<std::string> uniqueBlockTypes = prefab->getUniqueBlockTypes();
     std::cout << "Loading " << uniqueBlockTypes.size() << " unique block types...\n";
 
-    // Load all textures
+    // Load all textures, sorted so texture ids do not depend on hash order
     std::cout << "Loading textures...\n";
+    std::vector<std::pair<std::string, std::string>> textures;
     for (const std::string& blockName : uniqueBlockTypes) {
         std::string texturePath = blockModelRegistry.findTexturePath(blockName);
         if (!texturePath.empty() && texturePath != "EMPTY") {
-            textureRegistry.addTexture(texturePath, texturePath);
+            textures.emplace_back(texturePath, texturePath);
         }
     }
-
-    // Pack textures into atlas
-    std::cout << "Packing textures into atlas...\n";
-    textureRegistry.packTextures();
+    std::sort(textures.begin(), textures.end());
+    textureRegistry.addTextures(textures, config->decodeThreads);
 
     // Load models
     std::cout << "Loading models...\n";
@@ -44,39 +51,392 @@ void Export::exportPrefab()
         }
     }
 
-    // Generate mesh
-    std::cout << "Generating mesh...\n";
-    PrefabMesher prefabMesher(&blockModelRegistry, &textureRegistry);
-    Mesh prefabMesh;
-    prefabMesher.generatePrefabMesh(*prefab, prefabMesh);
+    // Pack textures into atlas, only the parts models use when trimming
+    std::cout << "Packing textures into atlas...\n";
+    if (config->trimAtlas) {
+        blockModelRegistry.addUsedTexels();
+    }
+    textureRegistry.packTextures();
 
-    std::cout << "Mesh generated with " << prefabMesh.vertices.size()
-        << " vertices and " << prefabMesh.faces.size() << " faces\n";
+    PrefabMesher prefabMesher(&blockModelRegistry, &textureRegistry);
+    prefabMesher.setSimplification(config->simplifyTriangles);
 
-    std::vector<Mesh> meshes = { prefabMesh };
+    ExteriorShell shell;
+    if (config->exteriorShell) {
+        buildExteriorShell(*prefab, blockModelRegistry, textureRegistry, shell);
+        prefabMesher.setExteriorShell(&shell);
+    }
 
-    // Export
-    std::cout << "Exporting...\n";
     std::string outputFilename = config->outputName + ".obj";
     OBJExporter::OBJExportOptions options;
     options.outputDirectory = config->outputPath;
     options.exportMTL = true;
     options.exportTextures = true;
     options.flipVCoordinate = true;
+    options.pngLevel = config->pngLevel;
+    options.exportDDS = config->ddsAtlas;
+    options.ddsFormat = config->ddsFormat;
+    options.exportMips = config->mipPNGs;
+    options.mipFilter = config->mipFilter;
+
+    bool success = config->instanced ?
+        exportInstanced(*prefab, prefabMesher, blockModelRegistry, textureRegistry, outputFilename, options,
+            config->exteriorShell ? &shell : nullptr) :
+        exportFlattened(*prefab, prefabMesher, textureRegistry, outputFilename, options);
 
-    OBJExporter exporter;
-    bool success = exporter.exportMeshes(meshes, outputFilename, config->assetsPath, &textureRegistry, options);
+    const PrefabMesher::SimplifyStats& simplified = prefabMesher.getSimplifyStats();
+    if (success && simplified.modelCount > 0) {
+        std::cout << "  Simplified " << simplified.modelCount << " models from " << simplified.trianglesBefore
+            << " to " << simplified.trianglesAfter << " triangles\n";
+    }
+
+    if (success && config->lodLevels > 0) {
+        success = exportLODs(*prefab, prefabMesher, blockModelRegistry, textureRegistry, options);
+    }
+
+    if (success && config->stats) {
+        printStats(*prefab, uniqueBlockTypes.size(), textureRegistry);
+    }
 
     if (success) {
         std::cout << "Export complete!\n";
         std::cout << "  OBJ: " << config->outputPath << "\\" << outputFilename << "\n";
         std::cout << "  MTL: " << config->outputPath << "\\" << config->outputName << ".mtl\n";
         if (options.exportTextures) {
-            std::cout << "  Texture: " << config->outputPath << "\\"
-                << config->outputName << "_atlas.png\n";
+            for (uint32_t page = 0; page < textureRegistry.getPageCount(); ++page) {
+                std::cout << "  Texture: " << config->outputPath << "\\"
+                    << OBJExporter::getAtlasPageFilename(config->outputName + "_atlas.png", page) << "\n";
+                if (options.exportDDS) {
+                    std::cout << "  Compressed: " << config->outputPath << "\\"
+                        << OBJExporter::getAtlasPageFilename(config->outputName + "_atlas.dds", page) << "\n";
+                }
+                if (options.exportMips) {
+                    std::cout << "  Mips: " << config->outputPath << "\\" << OBJExporter::getMipFilename(
+                        OBJExporter::getAtlasPageFilename(config->outputName + "_atlas.png", page), 1) << " and below\n";
+                }
+            }
+        }
+        for (int level = 1; level <= config->lodLevels; ++level) {
+            std::cout << "  LOD " << level << ": " << config->outputPath << "\\"
+                << config->outputName << "_lod" << level << ".obj\n";
+        }
+        if (config->meshlets && !config->instanced) {
+            std::cout << "  Meshlets: " << config->outputPath << "\\"
+                << config->outputName << "_meshlets.bin\n";
+        }
+        if (config->instanced) {
+            std::cout << "  Instances: " << config->outputPath << "\\"
+                << config->outputName << "_instances.json\n";
         }
     }
     else {
         std::cerr << "Export failed!\n";
     }
-}
\ No newline at end of file
+}
+
+void Export::optimizeMesh(Mesh& mesh, VertexCacheStats& before, VertexCacheStats& after) const
+{
+    before.add(MeshOptimizer::analyzeVertexCache(mesh));
+
+    MeshOptimizer::triangulate(mesh);
+    MeshOptimizer::weldVertices(mesh);
+    MeshOptimizer::optimizeVertexCache(mesh);
+    if (config->optimizeOverdraw) {
+        MeshOptimizer::optimizeOverdraw(mesh);
+    }
+    MeshOptimizer::optimizeVertexFetch(mesh);
+
+    after.add(MeshOptimizer::analyzeVertexCache(mesh));
+}
+
+void Export::printStats(const Prefab& prefab, size_t blockTypeCount, const TextureRegistry& textureRegistry) const
+{
+    // Everything here was tracked while parsing and writing, nothing is walked again
+    Vec3 size = prefab.getSize();
+    Vec3 minBlock = prefab.getMinBounds();
+    std::cout << "Statistics:\n";
+    std::cout << "  Blocks:    " << prefab.getBlocks().size() << " of " << blockTypeCount << " types\n";
+    std::cout << "  Extent:    " << size.x << " x " << size.y << " x " << size.z << " blocks from ("
+        << minBlock.x << ", " << minBlock.y << ", " << minBlock.z << ")\n";
+    if (config->instanced) {
+        std::cout << "  Templates: " << stats.templateCount << " with " << stats.instanceCount << " instances\n";
+    }
+    std::cout << "  Vertices:  " << stats.vertexCount << "\n";
+    std::cout << "  Faces:     " << stats.faceCount << "\n";
+    if (stats.hasBounds) {
+        std::cout << "  Bounds:    (" << stats.minBounds.x << ", " << stats.minBounds.y << ", " << stats.minBounds.z
+            << ") to (" << stats.maxBounds.x << ", " << stats.maxBounds.y << ", " << stats.maxBounds.z << ")\n";
+    }
+    for (uint32_t page = 0; page < textureRegistry.getPageCount(); ++page) {
+        std::cout << "  Atlas:     " << textureRegistry.getAtlasWidth(page) << " x " << textureRegistry.getAtlasHeight(page)
+            << (page > 0 ? " (page " + std::to_string(page) + ")" : "") << "\n";
+    }
+}
+
+static void printCacheStats(const VertexCacheStats& before, const VertexCacheStats& after)
+{
+    std::cout << "  Vertex cache ACMR: " << std::fixed << std::setprecision(3) << before.getACMR()
+        << " -> " << after.getACMR() << std::defaultfloat << std::setprecision(6) << "\n";
+}
+
+void Export::buildExteriorShell(const Prefab& prefab, ModelRegistry& modelRegistry,
+    TextureRegistry& textureRegistry, ExteriorShell& shell)
+{
+    std::cout << "Finding exterior shell...\n";
+    BlockPalette palette = ChunkPartitioner::buildPalette(prefab);
+
+    // Only opaque full cubes stop the fill, everything else lets air and sight through
+    std::vector<bool> solid(palette.names.size(), false);
+    for (size_t id = 0; id < palette.names.size(); ++id) {
+        if (id == BlockPalette::Empty) continue;
+
+        Model* model = modelRegistry.getModel(palette.names[id]);
+        if (!model || !model->isCube) continue;
+
+        std::string texturePath = modelRegistry.findTexturePath(palette.names[id]);
+        solid[id] = !texturePath.empty() && texturePath != "EMPTY" && textureRegistry.isOpaque(texturePath);
+    }
+
+    shell.build(prefab, palette, solid, config->dropBottom);
+    std::cout << "  " << shell.getEnclosedCount() << " enclosed cells hidden\n";
+}
+
+bool Export::exportFlattened(const Prefab& prefab, PrefabMesher& prefabMesher,
+    TextureRegistry& textureRegistry, const std::string& outputFilename, const OBJExportOptions& options)
+{
+    std::vector<PrefabChunk> chunks = ChunkPartitioner::partition(prefab);
+
+    OBJStreamWriter writer(outputFilename, options);
+    if (!writer.open()) {
+        return false;
+    }
+
+    MeshletWriter meshletWriter(config->outputPath + "/" + config->outputName + "_meshlets.bin");
+    if (config->meshlets && !meshletWriter.open()) {
+        return false;
+    }
+    MeshletData meshletData;
+
+    // Chunks are meshed into one batch that is written out and reused whenever it
+    // reaches half the budget, leaving room for the material sort's scratch buffer.
+    // The check runs after every block, so a dense chunk cannot overshoot by its size.
+    size_t budgetBytes = config->memoryBudgetMB * 1024 * 1024;
+    Mesh batch;
+    prefabMesher.beginMesh(batch);
+    VertexCacheStats cacheBefore, cacheAfter;
+
+    auto flushBatch = [&]() -> bool {
+        if (batch.faces.empty()) return true;
+        batch.sortFacesByMaterial();
+        if (config->optimizeIndices) {
+            optimizeMesh(batch, cacheBefore, cacheAfter);
+        }
+        if (config->meshlets) {
+            MeshletBuilder::build(batch, meshletData);
+            if (!meshletWriter.writeMeshlets(meshletData, writer.getVertexCount(), writer.getFaceCount())) {
+                return false;
+            }
+        }
+        bool written = writer.writeMesh(batch);
+        prefabMesher.beginMesh(batch);
+        return written;
+    };
+
+    std::cout << "Generating mesh from " << chunks.size() << " chunks...\n";
+    for (const auto& chunk : chunks) {
+        for (uint32_t blockIndex : chunk.blockIndices) {
+            prefabMesher.generateBlockMesh(prefab.getBlocks()[blockIndex], batch);
+            if (batch.memoryUsage() * 2 >= budgetBytes && !flushBatch()) {
+                return false;
+            }
+        }
+    }
+
+    if (!flushBatch()) {
+        return false;
+    }
+
+    std::cout << "Mesh generated with " << writer.getVertexCount()
+        << " vertices and " << writer.getFaceCount() << " faces\n";
+    stats.vertexCount = writer.getVertexCount();
+    stats.faceCount = writer.getFaceCount();
+    stats.minBounds = writer.getMinBounds();
+    stats.maxBounds = writer.getMaxBounds();
+    stats.hasBounds = stats.vertexCount > 0;
+    if (config->optimizeIndices) {
+        printCacheStats(cacheBefore, cacheAfter);
+    }
+    if (config->meshlets) {
+        std::cout << "  " << meshletWriter.getMeshletCount() << " meshlets\n";
+        if (!meshletWriter.finish()) {
+            return false;
+        }
+    }
+
+    // Export
+    std::cout << "Exporting...\n";
+    return writer.finish(config->assetsPath, &textureRegistry);
+}
+
+bool Export::exportLODs(const Prefab& prefab, PrefabMesher& prefabMesher, ModelRegistry& modelRegistry,
+    TextureRegistry& textureRegistry, const OBJExportOptions& options)
+{
+    BlockPalette palette = ChunkPartitioner::buildPalette(prefab);
+
+    LODMesher lodMesher(&prefabMesher, &modelRegistry, &textureRegistry);
+    lodMesher.prepare(palette);
+
+    // LOD meshes share the full-detail atlas
+    OBJExportOptions lodOptions = options;
+    lodOptions.atlasFilename = config->outputName + "_atlas.png";
+
+    int levelCount = std::min(config->lodLevels, LODMesher::MaxLevel);
+    for (int level = 1; level <= levelCount; ++level) {
+        std::cout << "Generating LOD " << level << " (" << (1 << level) << "x)...\n";
+        lodMesher.buildLevel(prefab, palette, level);
+        const size_t chunkCount = lodMesher.getChunkCount();
+
+        std::string lodName = config->outputName + "_lod" + std::to_string(level);
+        OBJStreamWriter writer(lodName + ".obj", lodOptions);
+        if (!writer.open()) {
+            return false;
+        }
+
+        MeshletWriter meshletWriter(config->outputPath + "/" + lodName + "_meshlets.bin");
+        if (config->meshlets && !meshletWriter.open()) {
+            return false;
+        }
+
+        // Chunks are meshed in parallel a group at a time and written in chunk order
+        const size_t groupSize = static_cast<size_t>(Parallel::getThreadCount()) * 4;
+        std::vector<Mesh> chunkMeshes;
+        std::vector<VertexCacheStats> chunkBefore, chunkAfter;
+        std::vector<MeshletData> chunkMeshlets;
+        VertexCacheStats cacheBefore, cacheAfter;
+        for (size_t start = 0; start < chunkCount; start += groupSize) {
+            size_t count = std::min(groupSize, chunkCount - start);
+            chunkMeshes.assign(count, Mesh());
+            chunkBefore.assign(count, VertexCacheStats());
+            chunkAfter.assign(count, VertexCacheStats());
+            chunkMeshlets.assign(count, MeshletData());
+
+            Parallel::forEach(count, [&](size_t i) {
+                lodMesher.generateChunkLOD(start + i, chunkMeshes[i]);
+                chunkMeshes[i].sortFacesByMaterial();
+                if (config->optimizeIndices) {
+                    optimizeMesh(chunkMeshes[i], chunkBefore[i], chunkAfter[i]);
+                }
+                // Chunks already fill every core, so each builds its meshlets on its own thread
+                if (config->meshlets) {
+                    MeshletBuilder::build(chunkMeshes[i], chunkMeshlets[i], 1);
+                }
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                if (config->meshlets && !meshletWriter.writeMeshlets(chunkMeshlets[i],
+                    writer.getVertexCount(), writer.getFaceCount())) {
+                    return false;
+                }
+                if (!chunkMeshes[i].faces.empty() && !writer.writeMesh(chunkMeshes[i])) {
+                    return false;
+                }
+                cacheBefore.add(chunkBefore[i]);
+                cacheAfter.add(chunkAfter[i]);
+            }
+        }
+
+        std::cout << "  " << writer.getVertexCount() << " vertices and " << writer.getFaceCount() << " faces\n";
+        if (config->optimizeIndices) {
+            printCacheStats(cacheBefore, cacheAfter);
+        }
+        if (config->meshlets) {
+            std::cout << "  " << meshletWriter.getMeshletCount() << " meshlets\n";
+            if (!meshletWriter.finish()) {
+                return false;
+            }
+        }
+        if (!writer.finish(config->assetsPath, &textureRegistry)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Export::exportInstanced(const Prefab& prefab, PrefabMesher& prefabMesher, ModelRegistry& modelRegistry,
+    TextureRegistry& textureRegistry, const std::string& outputFilename, const OBJExportOptions& options,
+    const ExteriorShell* shell)
+{
+    // One template per block type with geometry, in order of first appearance
+    std::cout << "Baking model templates...\n";
+    std::vector<Mesh> templates;
+    std::vector<std::vector<MeshInstance>> instances;
+    std::unordered_map<std::string, size_t> templateIndices;
+    size_t instanceCount = 0;
+    VertexCacheStats cacheBefore, cacheAfter;
+
+    for (const auto& block : prefab.getBlocks()) {
+        if (block.name == "Empty" || block.name.empty()) continue;
+
+        // Instances keep their whole template, so only blocks hidden on every side are dropped
+        if (shell) {
+            bool hidden = shell->isEnclosed(block.x, block.y, block.z);
+            if (!hidden && shell->getVisibleFaces(block.x, block.y, block.z) == 0) {
+                Model* model = modelRegistry.getModel(block.name);
+                hidden = model && model->isCube;
+            }
+            if (hidden) continue;
+        }
+
+        auto it = templateIndices.find(block.name);
+        if (it == templateIndices.end()) {
+            Model* model = modelRegistry.getModel(block.name);
+            if (!model || model->nodeCount == 0 || prefabMesher.getModelTemplate(*model).faces.empty()) {
+                continue;
+            }
+
+            Mesh modelTemplate = prefabMesher.getModelTemplate(*model);
+            modelTemplate.name = block.name;
+            modelTemplate.sortFacesByMaterial();
+            if (config->optimizeIndices) {
+                optimizeMesh(modelTemplate, cacheBefore, cacheAfter);
+            }
+
+            it = templateIndices.emplace(block.name, templates.size()).first;
+            templates.push_back(std::move(modelTemplate));
+            instances.emplace_back();
+        }
+
+        uint8_t orientation = BlockRotation::toOrientation(block.rotation);
+        instances[it->second].push_back({ block.x, block.y, block.z, orientation });
+        instanceCount++;
+
+        // World bounds come from the cached bounds of the rotated template
+        if (config->stats) {
+            const Mesh& placed = prefabMesher.getModelTemplate(*modelRegistry.getModel(block.name), orientation);
+            Vec3 position(static_cast<float>(block.x), static_cast<float>(block.y), static_cast<float>(block.z));
+            stats.minBounds = stats.hasBounds ? Vec3::Min(stats.minBounds, placed.minBounds + position) :
+                placed.minBounds + position;
+            stats.maxBounds = stats.hasBounds ? Vec3::Max(stats.maxBounds, placed.maxBounds + position) :
+                placed.maxBounds + position;
+            stats.hasBounds = true;
+        }
+    }
+
+    stats.templateCount = templates.size();
+    stats.instanceCount = instanceCount;
+    for (const auto& modelTemplate : templates) {
+        stats.vertexCount += modelTemplate.vertices.size();
+        stats.faceCount += modelTemplate.faces.size();
+    }
+
+    std::cout << "Baked " << templates.size() << " templates for " << instanceCount << " instances\n";
+    if (config->optimizeIndices) {
+        printCacheStats(cacheBefore, cacheAfter);
+    }
+
+    // Export
+    std::cout << "Exporting...\n";
+    return OBJExporter::exportInstancedMeshes(templates, instances, outputFilename,
+        config->assetsPath, &textureRegistry, options);
+}
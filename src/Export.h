@@ -1,11 +1,56 @@
 #pragma once
+#include "data/Vec.h"
+#include "output/PNGLevel.h"
+#include "output/DDSFormat.h"
+#include "output/MipFilter.h"
 #include <string>
+#include <cstddef>
+#include <cstdint>
+
+struct Prefab;
+struct OBJExportOptions;
+struct Mesh;
+struct VertexCacheStats;
+class PrefabMesher;
+class ModelRegistry;
+class TextureRegistry;
+class ExteriorShell;
 
 struct ExportConfig {
 	std::string prefabPath;
 	std::string assetsPath;
 	std::string outputPath;
 	std::string outputName;
+	bool instanced = false;
+	size_t memoryBudgetMB = 512; // Upper bound for the output mesh batch held while streaming
+	int lodLevels = 0; // Extra meshes at 2x, 4x, ... coarser voxel resolution
+	bool exteriorShell = false; // Skip faces that cannot be seen from outside the prefab
+	bool dropBottom = false; // With exteriorShell, also skip the underside of the lowest layer
+	bool optimizeIndices = false; // Triangulate and reorder faces for the GPU vertex cache
+	bool optimizeOverdraw = false; // With optimizeIndices, also draw outward-facing clusters first
+	uint32_t simplifyTriangles = 0; // Triangle budget per custom model template, 0 disables
+	bool meshlets = false; // Write a meshlet side buffer per OBJ, needs optimizeIndices
+	bool stats = false; // Print a summary of the prefab and the exported mesh
+	uint32_t maxAtlasSize = 8192; // Largest atlas page side in pixels, a power of two
+	bool trimAtlas = false; // Pack only the texels visible faces sample
+	unsigned int decodeThreads = 0; // Most textures decoded at once, 0 for one per core
+	PNGLevel pngLevel = PNGLevel::Default; // Atlas PNG compression
+	bool ddsAtlas = false; // Also write block-compressed DDS atlas pages with mips
+	DDSFormat ddsFormat = DDSFormat::Auto;
+	uint32_t atlasGutter = 0; // Texels of edge padding around every packed block
+	bool mipPNGs = false; // Also write each atlas mip level as a PNG
+	MipFilter mipFilter = MipFilter::Box;
+};
+
+// Totals of the full-detail export, gathered while it is written
+struct ExportStats {
+	uint64_t vertexCount = 0;
+	uint64_t faceCount = 0;
+	uint64_t instanceCount = 0;
+	size_t templateCount = 0;
+	bool hasBounds = false;
+	Vec3 minBounds;
+	Vec3 maxBounds;
 };
 
 class Export {
@@ -15,4 +60,18 @@ public:
 	void exportPrefab();
 private:
 	ExportConfig* config;
+	ExportStats stats;
+
+	void printStats(const Prefab& prefab, size_t blockTypeCount, const TextureRegistry& textureRegistry) const;
+
+	void optimizeMesh(Mesh& mesh, VertexCacheStats& before, VertexCacheStats& after) const;
+	void buildExteriorShell(const Prefab& prefab, ModelRegistry& modelRegistry,
+		TextureRegistry& textureRegistry, ExteriorShell& shell);
+	bool exportFlattened(const Prefab& prefab, PrefabMesher& prefabMesher,
+		TextureRegistry& textureRegistry, const std::string& outputFilename, const OBJExportOptions& options);
+	bool exportLODs(const Prefab& prefab, PrefabMesher& prefabMesher, ModelRegistry& modelRegistry,
+		TextureRegistry& textureRegistry, const OBJExportOptions& options);
+	bool exportInstanced(const Prefab& prefab, PrefabMesher& prefabMesher, ModelRegistry& modelRegistry,
+		TextureRegistry& textureRegistry, const std::string& outputFilename, const OBJExportOptions& options,
+		const ExteriorShell* shell);
 };
\ No newline at end of file
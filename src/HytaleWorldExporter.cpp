@@ -1,4 +1,7 @@
 ﻿#include "Export.h"
+#include "output/PNGWriter.h"
+#include "output/DDSWriter.h"
+#include "output/MipGenerator.h"
 #include <iostream>
 #include <string>
 
@@ -22,6 +25,25 @@ void printUsage(const char* programName) {
         << "  -o, --output <path>      Output directory\n"
         << "\nOptional:\n"
         << "  -n, --name <name>        Output filename (default: prefab)\n"
+        << "  -i, --instanced          Write each block model once plus an instance list\n"
+        << "  -m, --memory-budget <MB> Mesh memory held before streaming to disk (default: 512)\n"
+        << "                           Covers the output mesh only, not the prefab or model data\n"
+        << "  -l, --lod <levels>       Also write 1-3 meshes at 2x, 4x and 8x coarser resolution\n"
+        << "  -s, --shell              Only keep faces visible from outside the prefab\n"
+        << "      --drop-bottom        With --shell, also remove the underside of the lowest layer\n"
+        << "  -t, --optimize           Write triangles ordered for the GPU vertex cache\n"
+        << "      --overdraw           With --optimize, also order faces to reduce overdraw\n"
+        << "      --simplify <tris>    Simplify custom models above this many triangles\n"
+        << "      --meshlets           Write <name>_meshlets.bin clusters for each OBJ (implies --optimize)\n"
+        << "      --trim-atlas         Pack only the texture areas models use into the atlas\n"
+        << "      --atlas-size <px>    Largest atlas page side, more pages are added beyond it (default: 8192)\n"
+        << "      --decode-threads <n> Most textures decoded at once (default: one per core)\n"
+        << "      --png-level <level>  Atlas PNG compression: store, fast, default or best (default: default)\n"
+        << "      --dds <format>       Also write the atlas as DDS with mips: auto, bc1, bc3 or bc7\n"
+        << "      --mips               Also write every atlas mip level as <atlas>_mip<N>.png\n"
+        << "      --mip-filter <name>  Mip downsampling filter: box or kaiser (default: box)\n"
+        << "      --gutter <px>        Edge padding around each packed texture, keeps mips from bleeding (default: 0)\n"
+        << "      --stats              Print block, mesh and atlas statistics after exporting\n"
         << "  -h, --help               Show this help\n"
         << "\nExample:\n"
         << "  " << programName << " -p house.prefab.json -a C:/User/me/unzippedHytale/Assets -o ./out\n";
@@ -38,6 +60,52 @@ bool parseArgs(int argc, char* argv[], ExportConfig& config) {
             return false;
         }
 
+        if (arg == "-i" || arg == "--instanced") {
+            config.instanced = true;
+            continue;
+        }
+
+        if (arg == "-s" || arg == "--shell") {
+            config.exteriorShell = true;
+            continue;
+        }
+
+        if (arg == "--drop-bottom") {
+            config.dropBottom = true;
+            continue;
+        }
+
+        if (arg == "-t" || arg == "--optimize") {
+            config.optimizeIndices = true;
+            continue;
+        }
+
+        if (arg == "--overdraw") {
+            config.optimizeOverdraw = true;
+            continue;
+        }
+
+        if (arg == "--trim-atlas") {
+            config.trimAtlas = true;
+            continue;
+        }
+
+        if (arg == "--mips") {
+            config.mipPNGs = true;
+            continue;
+        }
+
+        if (arg == "--stats") {
+            config.stats = true;
+            continue;
+        }
+
+        if (arg == "--meshlets") {
+            config.meshlets = true;
+            config.optimizeIndices = true;
+            continue;
+        }
+
         if (i + 1 >= argc && arg[0] == '-') {
             std::cerr << "Error: " << arg << " requires a value\n";
             return false;
@@ -55,6 +123,85 @@ bool parseArgs(int argc, char* argv[], ExportConfig& config) {
         else if (arg == "-n" || arg == "--name") {
             config.outputName = argv[++i];
         }
+        else if (arg == "-l" || arg == "--lod") {
+            try {
+                config.lodLevels = std::stoi(argv[++i]);
+            }
+            catch (const std::exception&) {
+                config.lodLevels = -1;
+            }
+            if (config.lodLevels < 0 || config.lodLevels > 3) {
+                std::cerr << "Error: --lod expects a level count from 0 to 3\n";
+                return false;
+            }
+        }
+        else if (arg == "--simplify") {
+            try {
+                config.simplifyTriangles = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            catch (const std::exception&) {
+                std::cerr << "Error: --simplify expects a triangle count\n";
+                return false;
+            }
+        }
+        else if (arg == "--decode-threads") {
+            try {
+                config.decodeThreads = static_cast<unsigned int>(std::stoul(argv[++i]));
+            }
+            catch (const std::exception&) {
+                std::cerr << "Error: --decode-threads expects a thread count\n";
+                return false;
+            }
+        }
+        else if (arg == "--png-level") {
+            if (!PNGWriter::parseLevel(argv[++i], config.pngLevel)) {
+                std::cerr << "Error: --png-level expects store, fast, default or best\n";
+                return false;
+            }
+        }
+        else if (arg == "--dds") {
+            if (!DDSWriter::parseFormat(argv[++i], config.ddsFormat)) {
+                std::cerr << "Error: --dds expects auto, bc1, bc3 or bc7\n";
+                return false;
+            }
+            config.ddsAtlas = true;
+        }
+        else if (arg == "--mip-filter") {
+            if (!MipGenerator::parseFilter(argv[++i], config.mipFilter)) {
+                std::cerr << "Error: --mip-filter expects box or kaiser\n";
+                return false;
+            }
+        }
+        else if (arg == "--gutter") {
+            try {
+                config.atlasGutter = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            catch (const std::exception&) {
+                std::cerr << "Error: --gutter expects a texel count\n";
+                return false;
+            }
+        }
+        else if (arg == "--atlas-size") {
+            try {
+                config.maxAtlasSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            catch (const std::exception&) {
+                config.maxAtlasSize = 0;
+            }
+            if (config.maxAtlasSize == 0 || (config.maxAtlasSize & (config.maxAtlasSize - 1)) != 0) {
+                std::cerr << "Error: --atlas-size expects a power of two\n";
+                return false;
+            }
+        }
+        else if (arg == "-m" || arg == "--memory-budget") {
+            try {
+                config.memoryBudgetMB = std::stoul(argv[++i]);
+            }
+            catch (const std::exception&) {
+                std::cerr << "Error: --memory-budget expects a size in MB\n";
+                return false;
+            }
+        }
         else {
             std::cerr << "Unknown argument: " << arg << "\n";
             return false;
@@ -73,6 +220,18 @@ bool parseArgs(int argc, char* argv[], ExportConfig& config) {
         std::cerr << "Error: --output is required\n";
         return false;
     }
+    if (config.dropBottom && !config.exteriorShell) {
+        std::cerr << "Error: --drop-bottom requires --shell\n";
+        return false;
+    }
+    if (config.meshlets && config.instanced) {
+        std::cerr << "Error: --meshlets is not supported with --instanced\n";
+        return false;
+    }
+    if (config.optimizeOverdraw && !config.optimizeIndices) {
+        std::cerr << "Error: --overdraw requires --optimize\n";
+        return false;
+    }
 
     return true;
 }
@@ -0,0 +1,68 @@
+// Times filling atlas pages from generated tiles, the copy packTextures does once the
+// layout is known. Tiles are random noise so none of them are merged as duplicates.
+//
+// Usage: AtlasBenchmark [tileCount] [tileSize] [runs]
+// The defaults, 256 tiles of 256x256, fill one 4096x4096 page.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../data/Model.h"
+#include "../output/PNGWriter.h"
+
+int main(int argc, char* argv[]) {
+	uint32_t tileCount = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 256;
+	uint32_t tileSize = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 256;
+	int runs = argc > 3 ? std::stoi(argv[3]) : 10;
+
+	std::filesystem::path tileDirectory = std::filesystem::temp_directory_path() / "AtlasBenchmark";
+	std::filesystem::create_directories(tileDirectory);
+
+	std::vector<std::pair<std::string, std::string>> tiles;
+	std::vector<uint8_t> pixels(static_cast<size_t>(tileSize) * tileSize * 4);
+	uint32_t state = 0x12345678;
+	for (uint32_t i = 0; i < tileCount; ++i) {
+		for (uint8_t& value : pixels) {
+			state = state * 1664525u + 1013904223u;
+			value = static_cast<uint8_t>(state >> 24);
+		}
+		std::string name = "tile" + std::to_string(i);
+		std::string path = (tileDirectory / (name + ".png")).string();
+		if (!PNGWriter::write(path, pixels.data(), tileSize, tileSize, PNGWriter::Level::Store)) {
+			std::cerr << "Failed to write " << path << std::endl;
+			return 1;
+		}
+		tiles.emplace_back(name, path);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	double bestDecode = 0.0, bestPack = 0.0;
+	uint32_t pageCount = 0;
+	for (int run = 0; run < runs; ++run) {
+		TextureRegistry registry(TextureRegistry::DefaultMaxAtlasSize, tileSize);
+
+		Clock::time_point start = Clock::now();
+		registry.addTextures(tiles);
+		Clock::time_point decoded = Clock::now();
+		registry.packTextures();
+		Clock::time_point packed = Clock::now();
+
+		double decodeMs = std::chrono::duration<double, std::milli>(decoded - start).count();
+		double packMs = std::chrono::duration<double, std::milli>(packed - decoded).count();
+		bestDecode = run == 0 ? decodeMs : std::min(bestDecode, decodeMs);
+		bestPack = run == 0 ? packMs : std::min(bestPack, packMs);
+		pageCount = registry.getPageCount();
+	}
+
+	std::filesystem::remove_all(tileDirectory);
+
+	std::cout << tileCount << " tiles of " << tileSize << "x" << tileSize << " on " << pageCount
+		<< " page(s), best of " << runs << " runs\n";
+	std::cout << "  Decode: " << bestDecode << " ms\n";
+	std::cout << "  Pack:   " << bestPack << " ms" << std::endl;
+	return 0;
+}
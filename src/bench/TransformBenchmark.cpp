@@ -0,0 +1,83 @@
+// Times the batch transform kernels against their scalar reference paths on random
+// SoA streams, for positions and for normals with and without renormalization.
+//
+// Usage: TransformBenchmark [vertexCount] [runs]
+// Build with HYTALE_EXPORTER_AVX2 to time the AVX2 kernels instead of SSE.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../geometry/TransformKernel.h"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// Best time of all runs in nanoseconds per vertex
+	template <typename Function>
+	double timeBest(size_t count, int runs, Function&& function) {
+		double best = 0.0;
+		for (int run = 0; run < runs; ++run) {
+			Clock::time_point start = Clock::now();
+			function();
+			double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+			best = run == 0 ? ns : std::min(best, ns);
+		}
+		return best;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	size_t count = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 65536;
+	int runs = argc > 2 ? std::stoi(argv[2]) : 200;
+
+	VertexStreams input, output;
+	input.resize(count);
+	output.resize(count);
+	uint32_t state = 0x12345678;
+	auto random = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return static_cast<float>(state >> 8) / 16777216.0f * 2.0f - 1.0f;
+	};
+	for (size_t i = 0; i < count; ++i) {
+		input.px[i] = random(); input.py[i] = random(); input.pz[i] = random();
+		input.nx[i] = random(); input.ny[i] = random(); input.nz[i] = random();
+	}
+
+	// A stretched node under a block rotation, as the template baker sees them
+	Mat4 matrix = Mat4::Translate(Vec3(0.25f, 0.5f, -0.125f)) * Mat4::RotateY(1.5707964f) *
+		Mat4::RotateX(0.5f) * Mat4::Scale(Vec3(1.0f, 2.0f, 0.5f));
+
+	double pointsScalar = timeBest(count, runs, [&]() {
+		TransformKernel::transformPointsScalar(matrix, input.px.data(), input.py.data(), input.pz.data(),
+			output.px.data(), output.py.data(), output.pz.data(), count);
+	});
+	double pointsBatch = timeBest(count, runs, [&]() {
+		TransformKernel::transformPoints(matrix, input.px.data(), input.py.data(), input.pz.data(),
+			output.px.data(), output.py.data(), output.pz.data(), count);
+	});
+
+	std::cout << count << " vertices, best of " << runs << " runs, ns per vertex\n";
+	std::cout << "  Points:                 scalar " << pointsScalar << ", batch " << pointsBatch << "\n";
+	for (bool normalize : { false, true }) {
+		double normalsScalar = timeBest(count, runs, [&]() {
+			TransformKernel::transformNormalsScalar(matrix, input.nx.data(), input.ny.data(), input.nz.data(),
+				output.nx.data(), output.ny.data(), output.nz.data(), count, normalize);
+		});
+		double normalsBatch = timeBest(count, runs, [&]() {
+			TransformKernel::transformNormals(matrix, input.nx.data(), input.ny.data(), input.nz.data(),
+				output.nx.data(), output.ny.data(), output.nz.data(), count, normalize);
+		});
+		std::cout << (normalize ? "  Normals, normalized:    scalar " : "  Normals, unnormalized:  scalar ")
+			<< normalsScalar << ", batch " << normalsBatch << "\n";
+	}
+
+	// Keeps the results observable so the transforms are not optimized away
+	float checksum = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		checksum += output.px[i] + output.nx[i];
+	}
+	std::cout << "  Checksum: " << checksum << std::endl;
+	return 0;
+}
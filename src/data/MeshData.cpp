@@ -0,0 +1,93 @@
+#include "MeshData.h"
+#include <cstddef>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define MESH_DATA_SSE
+#endif
+
+uint16_t Mesh::getOrAddMaterial(const std::string& name) {
+    return getOrAddMaterial(MeshMaterial{ .name = name });
+}
+
+uint16_t Mesh::getOrAddMaterial(const MeshMaterial& material) {
+    const std::string& name = material.name;
+    auto it = materialIds.find(name);
+    if (it != materialIds.end()) {
+        return it->second;
+    }
+
+    if (materials.size() >= MeshFace::NoMaterial) {
+        throw std::runtime_error("Mesh material table is full");
+    }
+
+    uint16_t id = static_cast<uint16_t>(materials.size());
+    materials.push_back(material);
+    materialIds[name] = id;
+    return id;
+}
+
+void Mesh::computeBounds() {
+    resetBounds();
+    if (vertices.empty()) return;
+
+#if defined(MESH_DATA_SSE)
+    // Each load takes x, y and z plus the u that follows them, whose lane is ignored
+    static_assert(offsetof(Vertex, position) == 0 && offsetof(Vertex, uv) == sizeof(float) * 3,
+        "Vertex position must be followed by a float");
+    __m128 low = _mm_loadu_ps(&vertices[0].position.x);
+    __m128 high = low;
+    for (const auto& vertex : vertices) {
+        __m128 position = _mm_loadu_ps(&vertex.position.x);
+        low = _mm_min_ps(low, position);
+        high = _mm_max_ps(high, position);
+    }
+
+    float lowValues[4], highValues[4];
+    _mm_storeu_ps(lowValues, low);
+    _mm_storeu_ps(highValues, high);
+    minBounds = Vec3(lowValues[0], lowValues[1], lowValues[2]);
+    maxBounds = Vec3(highValues[0], highValues[1], highValues[2]);
+#else
+    for (const auto& vertex : vertices) {
+        minBounds = Vec3::Min(minBounds, vertex.position);
+        maxBounds = Vec3::Max(maxBounds, vertex.position);
+    }
+#endif
+}
+
+void Mesh::sortFacesByMaterial() {
+    materialRanges.clear();
+    if (faces.empty()) return;
+
+    // One bucket per material plus a trailing bucket for faces using the mesh-level material
+    size_t bucketCount = materials.size() + 1;
+    auto bucketOf = [&](const MeshFace& face) -> size_t {
+        return face.material == MeshFace::NoMaterial ? materials.size() : face.material;
+    };
+
+    std::vector<uint32_t> counts(bucketCount, 0);
+    for (const auto& face : faces) {
+        counts[bucketOf(face)]++;
+    }
+
+    std::vector<uint32_t> starts(bucketCount, 0);
+    uint32_t running = 0;
+    for (size_t i = 0; i < bucketCount; ++i) {
+        starts[i] = running;
+        running += counts[i];
+
+        if (counts[i] > 0) {
+            uint16_t material = i == materials.size() ? MeshFace::NoMaterial : static_cast<uint16_t>(i);
+            materialRanges.push_back({ .material = material, .firstFace = starts[i], .faceCount = counts[i] });
+        }
+    }
+
+    // Stable scatter keeps faces of one material in generation order
+    std::vector<MeshFace> sorted(faces.size());
+    for (const auto& face : faces) {
+        sorted[starts[bucketOf(face)]++] = face;
+    }
+    faces.swap(sorted);
+}
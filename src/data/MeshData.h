@@ -1,5 +1,6 @@
 #pragma once
 #include "Vec.h"
+#include <cfloat>
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -13,36 +14,101 @@ struct Vertex {
 	Vec3 normal;
 };
 
+struct MeshMaterial {
+	std::string name;
+	Vec3 diffuse = Vec3(1, 1, 1);
+	bool textured = true; // Samples the texture atlas, otherwise a flat diffuse colour
+	uint32_t atlasPage = 0; // Atlas page the texture coordinates refer to
+};
+
+// Contiguous run of faces sharing one material (see Mesh::sortFacesByMaterial)
+struct MaterialRange {
+	uint16_t material;
+	uint32_t firstFace;
+	uint32_t faceCount;
+};
+
 // Can be quad or triangle
 struct MeshFace {
+	static constexpr uint16_t NoMaterial = 0xFFFF;
+
 	uint32_t indices[4];
 	uint8_t vertexCount;
-	std::string material;
+	uint16_t material; // Index into Mesh::materials, or NoMaterial for the mesh-level material
 
-	MeshFace() : vertexCount(4), material("") {
+	MeshFace() : vertexCount(4), material(NoMaterial) {
 		indices[0] = indices[1] = indices[2] = indices[3] = 0;
 	}
 };
 
 struct Mesh {
+	std::string name;
 	std::vector<Vertex> vertices;
 	std::vector<MeshFace> faces;
+	std::vector<MeshMaterial> materials;
+	std::vector<MaterialRange> materialRanges;
 	std::string materialName;
 
-	Vec3 minBounds;
-	Vec3 maxBounds;
+	// Bounds of every vertex added since the last clear, empty (min > max) until the first
+	Vec3 minBounds = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 maxBounds = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
 	inline uint32_t addVertex(const Vertex& v) {
 		vertices.push_back(v);
+		minBounds = Vec3::Min(minBounds, v.position);
+		maxBounds = Vec3::Max(maxBounds, v.position);
 		return static_cast<uint32_t>(vertices.size() - 1);
 	}
 
+	inline bool hasBounds() const {
+		return minBounds.x <= maxBounds.x;
+	}
+
+	// Grows the bounds to cover a box, for vertices added without addVertex
+	inline void mergeBounds(const Vec3& min, const Vec3& max) {
+		minBounds = Vec3::Min(minBounds, min);
+		maxBounds = Vec3::Max(maxBounds, max);
+	}
+
+	inline void resetBounds() {
+		minBounds = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		maxBounds = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	}
+
+	// Recomputes the bounds from the vertex buffer after positions were changed in place
+	void computeBounds();
+
 	inline void addFace(const MeshFace& f) {
 		faces.push_back(f);
 	}
 
+	// Bytes held by the vertex and face buffers, including unused capacity
+	inline size_t memoryUsage() const {
+		return vertices.capacity() * sizeof(Vertex) + faces.capacity() * sizeof(MeshFace);
+	}
+
+	// Returns the id of the named material, adding it to the table if needed
+	uint16_t getOrAddMaterial(const std::string& name);
+	uint16_t getOrAddMaterial(const MeshMaterial& material);
+
+	// Groups faces into contiguous per-material ranges with a counting sort
+	void sortFacesByMaterial();
+
 	inline void clear() {
 		vertices.clear();
 		faces.clear();
+		materials.clear();
+		materialRanges.clear();
+		materialIds.clear();
+		resetBounds();
 	}
-};
\ No newline at end of file
+
+private:
+	std::unordered_map<std::string, uint16_t> materialIds;
+};
+
+// Placement of a template mesh at a block position
+struct MeshInstance {
+	int32_t x, y, z;
+	uint8_t orientation; // Index into BlockRotation::Orientations
+};
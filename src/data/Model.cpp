@@ -2,11 +2,12 @@
 #include <iostream>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
 
 int Model::MaxNodeCount = 256;
 
 Model::Model(int preAllocatedNodeCount)
-    : nodeCount(0), allocatedNodeCount(preAllocatedNodeCount), gradientId(0) {
+    : nodeCount(0), allocatedNodeCount(preAllocatedNodeCount), gradientId(0), isCube(false), textureId(-1) {
 
     allNodes = new ModelNode[preAllocatedNodeCount];
     parentNodes = new int[preAllocatedNodeCount];
@@ -47,6 +48,8 @@ Model Model::clone() const {
 
     cloned.nodeCount = nodeCount;
     cloned.gradientId = gradientId;
+    cloned.isCube = isCube;
+    cloned.textureId = textureId;
     cloned.rootNodes = rootNodes;
     cloned.nodeIndicesByNameId = nodeIndicesByNameId;
 
@@ -72,15 +75,6 @@ void Model::attach(Model* attachment, NodeNameManager* nodeNameManager,
     }
 }
 
-void Model::setUV(Vec2 min, Vec2 max) {
-    for (int i = 0; i < nodeCount; i++) {
-        for (auto& layout : allNodes[i].textureLayout) {
-            layout.uvMin = min;
-            layout.uvMax = max;
-        }
-    }
-}
-
 void Model::setGradientId(uint8_t gradientId) {
     this->gradientId = gradientId;
     for (int i = 0; i < nodeCount; i++) {
@@ -272,6 +266,51 @@ ModelNode ModelNode::clone() const {
     return cloned;
 }
 
+Vec2 ModelNode::getFaceDimensions(size_t faceIndex) const {
+    if (type == ShapeType::Box) {
+        switch (faceIndex) {
+        case 0: // Front (-Z): width x height
+        case 1: // Back (+Z): width x height
+            return Vec2(size.x * stretch.x, size.y * stretch.y);
+        case 2: // Right (+X): depth x height
+        case 3: // Left (-X): depth x height
+            return Vec2(size.z * stretch.z, size.y * stretch.y);
+        case 4: // Top (+Y): width x depth
+        case 5: // Bottom (-Y): width x depth
+            return Vec2(size.x * stretch.x, size.z * stretch.z);
+        default:
+            return Vec2(size.x, size.y);
+        }
+    }
+    else if (type == ShapeType::Quad) {
+        return Vec2(size.x * stretch.x, size.y * stretch.y);
+    }
+    return Vec2(0, 0);
+}
+
+bool ModelNode::getFaceTexelRect(size_t faceIndex, uint32_t textureWidth, uint32_t textureHeight,
+    TexelRect& outRect) const {
+    if (type == ShapeType::None || textureWidth == 0 || textureHeight == 0) return false;
+
+    const ModelFaceTextureLayout& layout = textureLayout[faceIndex];
+    Vec2 dimensions = getFaceDimensions(faceIndex);
+    float u0 = std::min(layout.offset.u, layout.offset.u + dimensions.u);
+    float u1 = std::max(layout.offset.u, layout.offset.u + dimensions.u);
+    float v0 = std::min(layout.offset.v, layout.offset.v + dimensions.v);
+    float v1 = std::max(layout.offset.v, layout.offset.v + dimensions.v);
+
+    // Whole texels covering the footprint, at least one so degenerate faces still map
+    auto clampTexel = [](float value, uint32_t size) {
+        return static_cast<uint32_t>(std::clamp(value, 0.0f, static_cast<float>(size)));
+    };
+    uint32_t x0 = std::min(clampTexel(std::floor(u0), textureWidth), textureWidth - 1);
+    uint32_t y0 = std::min(clampTexel(std::floor(v0), textureHeight), textureHeight - 1);
+    uint32_t x1 = std::max(clampTexel(std::ceil(u1), textureWidth), x0 + 1);
+    uint32_t y1 = std::max(clampTexel(std::ceil(v1), textureHeight), y0 + 1);
+    outRect = { x0, y0, x1 - x0, y1 - y0 };
+    return true;
+}
+
 ShadingMode ModelInitializer::parseShadingMode(const std::string& shadingMode) {
     if (shadingMode == "flat") return ShadingMode::Flat;
     if (shadingMode == "fullbright") return ShadingMode::Fullbright;
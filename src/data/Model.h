@@ -1,13 +1,18 @@
 #pragma once
 #include "MeshData.h"
+#include "../output/PNGLevel.h"
+#include "../output/DDSFormat.h"
+#include "../output/MipFilter.h"
 #include <string>
 #include <memory>
 #include <vector>
 #include <array>
 #include <unordered_map>
 #include <cstdint>
+#include <cstring>
 
 class NodeNameManager;
+struct MipLevel;
 
 enum class ShadingMode {
 	Standard = 0,
@@ -16,17 +21,31 @@ enum class ShadingMode {
 	Reflective = 3
 };
 
+// Texel rectangle [x, x + width) x [y, y + height) of a source texture
+struct TexelRect {
+	uint32_t x, y, width, height;
+
+	bool contains(const TexelRect& other) const {
+		return other.x >= x && other.y >= y &&
+			other.x + other.width <= x + width && other.y + other.height <= y + height;
+	}
+	bool overlaps(const TexelRect& other) const {
+		return other.x < x + width && x < other.x + other.width &&
+			other.y < y + height && y < other.y + other.height;
+	}
+};
+
+// Where a face samples its model's texture. Stays in source texture pixels, atlas
+// coordinates are only worked out when meshing.
 struct ModelFaceTextureLayout {
 	Vec2 offset;
-	Vec2 uvMin;
-	Vec2 uvMax;
 	int angle;
 	bool mirrorX;
 	bool mirrorY;
 	bool hidden;
 
 	ModelFaceTextureLayout()
-		: offset(0, 0), uvMin(0, 0), uvMax(0, 0), angle(0), mirrorX(false), mirrorY(false), hidden(false) {
+		: offset(0, 0), angle(0), mirrorX(false), mirrorY(false), hidden(false) {
 	}
 };
 
@@ -85,6 +104,11 @@ struct ModelNode {
 	}
 
 	ModelNode clone() const;
+
+	// Pixel size of a face's texture footprint before any rotation
+	Vec2 getFaceDimensions(size_t faceIndex) const;
+	// Source texels a face samples, false for nodes without faces
+	bool getFaceTexelRect(size_t faceIndex, uint32_t textureWidth, uint32_t textureHeight, TexelRect& outRect) const;
 };
 
 struct Model {
@@ -98,6 +122,8 @@ struct Model {
 	int* parentNodes;
 	uint8_t gradientId;
 	int nodeCount;
+	bool isCube; // Built-in unit cube for blocks with DrawType Cube
+	int textureId; // TextureRegistry id of the model's texture, -1 when it has none
 
 private:
 	int allocatedNodeCount;
@@ -115,7 +141,6 @@ public:
 		Vec2 uvMin, Vec2 uvMax, Vec2* uvOffset = nullptr,
 		int forcedTargetNodeNameId = -1);
 
-	void setUV(Vec2 min, Vec2 max);
 	void setGradientId(uint8_t gradientId);
 	void offsetUVs(Vec2 offset);
 
@@ -205,45 +230,116 @@ private:
 		const std::string& faceName);
 };
 
-// UV bounds for a texture within an atlas
+// UV bounds within one atlas page of a texture, or of the part of it starting at
+// sourceX, sourceY when the atlas is trimmed
 struct AtlasRegion {
 	Vec2 uvMin;
 	Vec2 uvMax;
 	uint32_t pixelWidth;
 	uint32_t pixelHeight;
+	uint32_t page;
+	uint32_t sourceX;
+	uint32_t sourceY;
 };
 
 struct TextureSource {
 	std::string name;
-	uint8_t* data;
+	uint8_t* data; // RGBA, freed once packed
 	uint32_t width;
 	uint32_t height;
-	uint32_t channels;
+	std::vector<TexelRect> usedRects; // Empty packs the whole texture
 };
 
+// Packs textures into power-of-two atlas pages no larger than maxAtlasSize a side.
+// Textures that do not fit on a page spill onto the next one. Textures given used
+// rectangles only have those packed, merged where they overlap. Identical pixel
+// blocks are packed once and share a region. A non-zero gutter surrounds every block
+// with copies of its edge texels, so filtering and mips do not bleed between blocks.
 class TextureRegistry {
 private:
-	std::unordered_map<std::string, AtlasRegion> textureRegions;
-	std::unordered_map<std::string, TextureSource> textureSources;
-	uint32_t atlasWidth, atlasHeight;
+	// Top edge of the packed area over [x, x + width)
+	struct SkylineSegment {
+		uint32_t x, y, width;
+	};
+
+	// Part of a source texture packed as one block
+	struct PackItem {
+		int textureId;
+		const TextureSource* source;
+		TexelRect rect;
+		uint64_t hash; // Of the block's RGBA pixels and size
+	};
+
+	struct Placement {
+		const PackItem* item;
+		uint32_t x, y; // Of the block's texels, inside its gutter
+	};
+
+	struct AtlasPage {
+		uint32_t width, height;
+		std::unique_ptr<uint8_t[]> pixelData; // Allocated once the page size is known
+		bool opaque = true; // Every placed texel is fully opaque, the unused area aside
+	};
+
+	std::vector<TextureSource> textureSources; // Indexed by texture id
+	std::unordered_map<std::string, int> textureIds;
+	std::vector<std::vector<AtlasRegion>> textureRegions; // Indexed by texture id
+	std::vector<AtlasPage> pages;
+	uint32_t maxAtlasSize;
 	uint32_t standardTileSize;
-	std::unique_ptr<uint8_t[]> pixelData;
+	uint32_t gutter;
 	
-	void copyTextureToAtlas(const uint8_t* srcData, uint32_t srcWidth, uint32_t srcHeight,
-		uint32_t srcChannels, uint32_t dstX, uint32_t dstY);
+	int registerTexture(const std::string& name, uint8_t* data, int width, int height);
+	// Copies RGBA rows, sources are always decoded with four channels
+	void copyTextureToAtlas(AtlasPage& page, const uint8_t* srcData, uint32_t srcStride, uint32_t srcWidth,
+		uint32_t srcHeight, uint32_t dstX, uint32_t dstY);
+	// Fills the gutter around a placed block by repeating its edge texels outwards
+	void extrudeGutter(AtlasPage& page, uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+	// Skyline bottom-left placement of one texture: lowest top edge, then leftmost
+	static bool insertSkyline(std::vector<SkylineSegment>& skyline, uint32_t atlasWidth, uint32_t atlasHeight,
+		uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY);
+	// Packs items in order onto the next page, returning those left for later pages
+	std::vector<const PackItem*> packPage(const std::vector<const PackItem*>& items);
+	// Merges overlapping rectangles into their bounds until none overlap
+	static void mergeRects(std::vector<TexelRect>& rects);
+	static uint64_t hashPixels(const uint8_t* data, uint32_t stride, uint32_t width, uint32_t height);
+	const uint8_t* getRegionPixels(const AtlasRegion& region, uint32_t& stride) const;
 public:
-	TextureRegistry(uint32_t width, uint32_t height, uint32_t tileSize)
-		: atlasWidth(width), atlasHeight(height), standardTileSize(tileSize),
-		pixelData(std::make_unique<uint8_t[]>(width* height * 4)) {
-		std::memset(pixelData.get(), 0, width * height * 4);
+	static constexpr uint32_t DefaultMaxAtlasSize = 8192;
+
+	TextureRegistry(uint32_t maxAtlasSize, uint32_t tileSize, uint32_t gutter = 0)
+		: maxAtlasSize(maxAtlasSize), standardTileSize(tileSize), gutter(gutter) {
 	}
 
-	void addTexture(const std::string& name, const std::string& filepath);
+	// Decodes a texture once per name and returns its id
+	int addTexture(const std::string& name, const std::string& filepath);
+	// Decodes (name, filepath) pairs on up to maxDecodes threads at once, 0 for one per
+	// core. Ids follow the order of the list whatever order the decodes finish in.
+	void addTextures(const std::vector<std::pair<std::string, std::string>>& textures, unsigned int maxDecodes = 0);
+	int getTextureId(const std::string& name) const;
+	// Marks texels a face samples, so packing can leave out the rest of the texture
+	void addUsedRect(int textureId, const TexelRect& rect);
+	bool getTextureSize(int textureId, uint32_t& outWidth, uint32_t& outHeight) const;
 	void packTextures();
-	void exportAtlas(const std::string& outputPath) const;
-	uint32_t getAtlasWidth() const { return atlasWidth; }
-	uint32_t getAtlasHeight() const { return atlasHeight; }
-	const AtlasRegion* getTextureRegion(const std::string& name) const;
+	void exportAtlas(const std::string& outputPath, uint32_t page = 0,
+		PNGLevel level = PNGLevel::Default) const;
+	// Mip levels below a page, down to 1x1
+	std::vector<MipLevel> buildMipChain(uint32_t page, MipFilter filter = MipFilter::Box) const;
+	// Writes a page and the given mip levels below it as a block-compressed DDS. Auto
+	// picks BC1 when every placed texel on the page is opaque, BC3 otherwise.
+	void exportCompressedAtlas(const std::string& outputPath, uint32_t page, const std::vector<MipLevel>& mips,
+		DDSFormat format = DDSFormat::Auto) const;
+	uint32_t getPageCount() const { return static_cast<uint32_t>(pages.size()); }
+	uint32_t getAtlasWidth(uint32_t page = 0) const { return page < pages.size() ? pages[page].width : 0; }
+	uint32_t getAtlasHeight(uint32_t page = 0) const { return page < pages.size() ? pages[page].height : 0; }
+	// Region holding the given texels of a texture, null when they were not packed
+	const AtlasRegion* getTextureRegion(int textureId, const TexelRect& rect) const;
+	// Alpha-weighted mean colour of the packed texels of a texture, in 0-1 range
+	bool getAverageColor(const std::string& name, Vec3& outColor) const;
+	// True when every packed texel of a texture is fully opaque
+	bool isOpaque(const std::string& name) const;
+	// True when the given texels of a texture were packed and are all fully opaque
+	bool isOpaque(int textureId, const TexelRect& rect) const;
 };
 
 class ModelRegistry {
@@ -259,7 +355,10 @@ public:
 	std::string findModelPath(const std::string& modelName);
 	std::string findTexturePath(const std::string& modelName);
 
+	// Loads a model, linking it to its texture when that was added to the texture registry
 	Model* loadModel(const std::string& modelName);
+	// Tells the texture registry which texels the visible faces of loaded models use
+	void addUsedTexels();
 	Model* getModel(const std::string& modelName);
 	bool hasModel(const std::string& modelName) const;
 
@@ -1,10 +1,12 @@
 #pragma once
 #include "Vec.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 struct PrefabBlock {
     int x, y, z;
@@ -28,40 +30,47 @@ struct Prefab {
     int version;
     int blockIdVersion;
     Vec3 anchor;
-    std::vector<PrefabBlock> blocks;
     std::vector<PrefabFluid> fluids;
     std::string name;
 
-    Prefab() : version(0), blockIdVersion(0), anchor(0, 0, 0) {}
+    Prefab() : version(0), blockIdVersion(0), anchor(0, 0, 0),
+        minX(0), minY(0), minZ(0), maxX(0), maxY(0), maxZ(0) {}
 
-    Vec3 getMinBounds() const {
-        if (blocks.empty()) return Vec3(0, 0, 0);
-
-        Vec3 min(blocks[0].x, blocks[0].y, blocks[0].z);
-        for (const auto& block : blocks) {
-            if (block.x < min.x) min.x = static_cast<float>(block.x);
-            if (block.y < min.y) min.y = static_cast<float>(block.y);
-            if (block.z < min.z) min.z = static_cast<float>(block.z);
+    void addBlock(PrefabBlock&& block) {
+        if (blocks.empty()) {
+            minX = maxX = block.x;
+            minY = maxY = block.y;
+            minZ = maxZ = block.z;
         }
-        return min;
+        else {
+            minX = std::min(minX, block.x);
+            minY = std::min(minY, block.y);
+            minZ = std::min(minZ, block.z);
+            maxX = std::max(maxX, block.x);
+            maxY = std::max(maxY, block.y);
+            maxZ = std::max(maxZ, block.z);
+        }
+        blocks.push_back(std::move(block));
     }
 
-    Vec3 getMaxBounds() const {
-        if (blocks.empty()) return Vec3(0, 0, 0);
+    // Read-only, so every block goes through addBlock and the bounds stay current
+    const std::vector<PrefabBlock>& getBlocks() const {
+        return blocks;
+    }
 
-        Vec3 max(blocks[0].x, blocks[0].y, blocks[0].z);
-        for (const auto& block : blocks) {
-            if (block.x > max.x) max.x = static_cast<float>(block.x);
-            if (block.y > max.y) max.y = static_cast<float>(block.y);
-            if (block.z > max.z) max.z = static_cast<float>(block.z);
-        }
-        return max;
+    // Lowest and highest block coordinates, (0, 0, 0) for an empty prefab
+    Vec3 getMinBounds() const {
+        return Vec3(static_cast<float>(minX), static_cast<float>(minY), static_cast<float>(minZ));
+    }
+
+    Vec3 getMaxBounds() const {
+        return Vec3(static_cast<float>(maxX), static_cast<float>(maxY), static_cast<float>(maxZ));
     }
 
     Vec3 getSize() const {
-        Vec3 min = getMinBounds();
-        Vec3 max = getMaxBounds();
-        return Vec3(max.x - min.x + 1, max.y - min.y + 1, max.z - min.z + 1);
+        if (blocks.empty()) return Vec3(0, 0, 0);
+        return Vec3(static_cast<float>(maxX - minX + 1), static_cast<float>(maxY - minY + 1),
+            static_cast<float>(maxZ - minZ + 1));
     }
 
     std::unordered_set<std::string> getUniqueBlockTypes() const {
@@ -71,4 +80,9 @@ struct Prefab {
         }
         return uniqueTypes;
     }
+
+private:
+    std::vector<PrefabBlock> blocks;
+    int minX, minY, minZ;
+    int maxX, maxY, maxZ;
 };
\ No newline at end of file
@@ -126,6 +126,16 @@ struct Vec3 {
 	Vec3 operator*(const Vec3& other) const {
 		return Vec3(x * other.x, y * other.y, z * other.z);
 	}
+
+	// Component-wise minimum and maximum. Mesh::computeBounds reduces whole vertex
+	// arrays with SSE instead of calling these per vertex.
+	static Vec3 Min(const Vec3& a, const Vec3& b) {
+		return Vec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+	}
+
+	static Vec3 Max(const Vec3& a, const Vec3& b) {
+		return Vec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+	}
 };
 
 struct Vec2 {
@@ -0,0 +1,107 @@
+#pragma once
+#include "../data/Vec.h"
+#include <array>
+#include <cstdint>
+
+// Block rotations are stored as yaw + pitch * 4 + roll * 16, each a quarter turn.
+// The 64 encodings collapse onto the 24 axis-aligned orientations of a cube, which
+// are generated here at compile time so rotating a vertex is a single table lookup.
+namespace BlockRotation {
+	constexpr int RotationCount = 64;
+	constexpr int OrientationCount = 24;
+	constexpr uint8_t IdentityOrientation = 0;
+	// Blocks turn about the centre of their cell. Models have their origin at the bottom
+	// centre, so the pivot sits half a block above it.
+	constexpr float PivotY = 0.5f;
+
+	struct Matrix {
+		int8_t m[3][3];
+
+		constexpr bool operator==(const Matrix& other) const {
+			for (int i = 0; i < 3; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					if (m[i][j] != other.m[i][j]) return false;
+				}
+			}
+			return true;
+		}
+
+		constexpr Matrix operator*(const Matrix& other) const {
+			Matrix result{};
+			for (int i = 0; i < 3; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					int sum = 0;
+					for (int k = 0; k < 3; ++k) {
+						sum += m[i][k] * other.m[k][j];
+					}
+					result.m[i][j] = static_cast<int8_t>(sum);
+				}
+			}
+			return result;
+		}
+
+		// Directions only, positions also need the pivot
+		Vec3 apply(const Vec3& v) const {
+			return Vec3(
+				m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+				m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+				m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+		}
+	};
+
+	namespace detail {
+		constexpr Matrix Identity = { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } };
+		// Quarter turns: yaw maps (x, y, z) -> (z, y, -x), pitch (x, y, z) -> (x, -z, y),
+		// roll (x, y, z) -> (-y, x, z)
+		constexpr Matrix YawStep = { { { 0, 0, 1 }, { 0, 1, 0 }, { -1, 0, 0 } } };
+		constexpr Matrix PitchStep = { { { 1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } } };
+		constexpr Matrix RollStep = { { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } } };
+
+		constexpr Matrix power(const Matrix& step, int count) {
+			Matrix result = Identity;
+			for (int i = 0; i < count; ++i) {
+				result = step * result;
+			}
+			return result;
+		}
+
+		// Roll is applied first and yaw last, so encodings 0-3 are plain yaw turns
+		constexpr Matrix fromEncoding(int rotation) {
+			return power(YawStep, rotation % 4) * power(PitchStep, (rotation / 4) % 4) * power(RollStep, (rotation / 16) % 4);
+		}
+
+		struct Tables {
+			std::array<Matrix, OrientationCount> orientations{};
+			std::array<uint8_t, RotationCount> orientationByRotation{};
+			int orientationCount = 0;
+		};
+
+		constexpr Tables buildTables() {
+			Tables tables;
+			for (int rotation = 0; rotation < RotationCount; ++rotation) {
+				Matrix matrix = fromEncoding(rotation);
+
+				int index = 0;
+				while (index < tables.orientationCount && !(tables.orientations[index] == matrix)) {
+					++index;
+				}
+				if (index == tables.orientationCount) {
+					tables.orientations[tables.orientationCount++] = matrix;
+				}
+				tables.orientationByRotation[rotation] = static_cast<uint8_t>(index);
+			}
+			return tables;
+		}
+
+		constexpr Tables Generated = buildTables();
+		static_assert(Generated.orientationCount == OrientationCount, "Expected 24 unique block orientations");
+		static_assert(Generated.orientations[IdentityOrientation] == Identity, "Orientation 0 must be the identity");
+	}
+
+	constexpr std::array<Matrix, OrientationCount> Orientations = detail::Generated.orientations;
+	constexpr std::array<uint8_t, RotationCount> OrientationByRotation = detail::Generated.orientationByRotation;
+
+	constexpr uint8_t toOrientation(uint16_t rotation) {
+		return OrientationByRotation[rotation % RotationCount];
+	}
+}
@@ -0,0 +1,121 @@
+#include "ChunkPartitioner.h"
+#include <algorithm>
+#include <unordered_map>
+
+// Spreads the low 5 bits of v so two zero bits follow each one
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0x1F;
+    v = (v | (v << 8)) & 0x0000F00F;
+    v = (v | (v << 4)) & 0x000C30C3;
+    v = (v | (v << 2)) & 0x00249249;
+    return v;
+}
+
+static uint32_t bitWidth(uint32_t v) {
+    uint32_t bits = 0;
+    while (v != 0) {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+// LSD radix sort on 8-bit digits, skipping digits every key shares. Stable, so blocks
+// with equal keys keep their file order.
+static void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, uint32_t keyBits) {
+    std::vector<uint64_t> keyScratch(keys.size());
+    std::vector<uint32_t> valueScratch(values.size());
+
+    for (uint32_t shift = 0; shift < keyBits; shift += 8) {
+        size_t counts[256] = {};
+        for (uint64_t key : keys) {
+            counts[(key >> shift) & 0xFF]++;
+        }
+        if (counts[(keys[0] >> shift) & 0xFF] == keys.size()) continue;
+
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            size_t target = counts[(keys[i] >> shift) & 0xFF]++;
+            keyScratch[target] = keys[i];
+            valueScratch[target] = values[i];
+        }
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
+
+std::vector<PrefabChunk> ChunkPartitioner::partition(const Prefab& prefab) {
+    std::vector<PrefabChunk> result;
+    if (prefab.getBlocks().empty()) return result;
+
+    // Chunk coordinates relative to the lowest chunk, packed above the Z-order index of
+    // the block inside its chunk, so one sort gives chunk order and locality within it
+    Vec3 minBounds = prefab.getMinBounds();
+    Vec3 maxBounds = prefab.getMaxBounds();
+    int32_t minX = toChunkCoord(static_cast<int32_t>(minBounds.x));
+    int32_t minY = toChunkCoord(static_cast<int32_t>(minBounds.y));
+    int32_t minZ = toChunkCoord(static_cast<int32_t>(minBounds.z));
+    uint32_t bitsX = bitWidth(static_cast<uint32_t>(toChunkCoord(static_cast<int32_t>(maxBounds.x)) - minX));
+    uint32_t bitsY = bitWidth(static_cast<uint32_t>(toChunkCoord(static_cast<int32_t>(maxBounds.y)) - minY));
+    uint32_t bitsZ = bitWidth(static_cast<uint32_t>(toChunkCoord(static_cast<int32_t>(maxBounds.z)) - minZ));
+    constexpr uint32_t LocalBits = 15;
+    uint32_t keyBits = LocalBits + bitsY + bitsZ + bitsX;
+
+    std::vector<uint64_t> keys(prefab.getBlocks().size());
+    std::vector<uint32_t> order(prefab.getBlocks().size());
+    for (uint32_t i = 0; i < prefab.getBlocks().size(); ++i) {
+        const PrefabBlock& block = prefab.getBlocks()[i];
+        int32_t cx = toChunkCoord(block.x);
+        int32_t cy = toChunkCoord(block.y);
+        int32_t cz = toChunkCoord(block.z);
+        uint64_t chunkKey = ((static_cast<uint64_t>(cx - minX) << bitsZ | static_cast<uint64_t>(cz - minZ)) << bitsY) |
+            static_cast<uint64_t>(cy - minY);
+        uint32_t local = spreadBits(block.x - cx * ChunkSize) | spreadBits(block.y - cy * ChunkSize) << 1 |
+            spreadBits(block.z - cz * ChunkSize) << 2;
+        keys[i] = keyBits <= 64 ? (chunkKey << LocalBits | local) : chunkKey;
+        order[i] = i;
+    }
+
+    // Prefabs too large to pack a Z-order index beside the chunk key keep file order
+    // inside each chunk
+    radixSort(keys, order, std::min(keyBits, 64u));
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        uint64_t chunkKey = keyBits <= 64 ? keys[i] >> LocalBits : keys[i];
+        if (i == 0 || chunkKey != (keyBits <= 64 ? keys[i - 1] >> LocalBits : keys[i - 1])) {
+            const PrefabBlock& block = prefab.getBlocks()[order[i]];
+            result.emplace_back();
+            result.back().chunkX = toChunkCoord(block.x);
+            result.back().chunkY = toChunkCoord(block.y);
+            result.back().chunkZ = toChunkCoord(block.z);
+        }
+        result.back().blockIndices.push_back(order[i]);
+    }
+    return result;
+}
+
+BlockPalette ChunkPartitioner::buildPalette(const Prefab& prefab) {
+    BlockPalette palette;
+    palette.names.push_back("Empty");
+    palette.blockIds.reserve(prefab.getBlocks().size());
+
+    std::unordered_map<std::string, uint16_t> ids;
+    ids["Empty"] = BlockPalette::Empty;
+    ids[""] = BlockPalette::Empty;
+
+    for (const auto& block : prefab.getBlocks()) {
+        auto it = ids.find(block.name);
+        if (it == ids.end()) {
+            it = ids.emplace(block.name, static_cast<uint16_t>(palette.names.size())).first;
+            palette.names.push_back(block.name);
+        }
+        palette.blockIds.push_back(it->second);
+    }
+
+    return palette;
+}
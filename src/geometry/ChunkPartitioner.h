@@ -0,0 +1,41 @@
+#pragma once
+#include "../data/Prefab.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Blocks of a prefab that fall into one ChunkSize^3 cell of the world grid
+struct PrefabChunk {
+    int32_t chunkX, chunkY, chunkZ;
+    std::vector<uint32_t> blockIndices; // Indices into Prefab::blocks
+
+    PrefabChunk() : chunkX(0), chunkY(0), chunkZ(0) {}
+};
+
+// Dense ids for the block types of a prefab, with id 0 reserved for empty cells
+struct BlockPalette {
+    static constexpr uint16_t Empty = 0;
+
+    std::vector<std::string> names; // Block type name per id, names[Empty] is "Empty"
+    std::vector<uint16_t> blockIds; // Palette id per entry in Prefab::blocks
+};
+
+class ChunkPartitioner {
+public:
+    static constexpr int32_t ChunkSize = 32;
+
+    // Groups blocks by chunk, ordered by chunk X, then Z, then Y, with the blocks of a
+    // chunk in Z-order so neighbours are meshed close together
+    static std::vector<PrefabChunk> partition(const Prefab& prefab);
+
+    static BlockPalette buildPalette(const Prefab& prefab);
+
+    static size_t voxelIndex(int32_t localX, int32_t localY, int32_t localZ) {
+        return (static_cast<size_t>(localY) * ChunkSize + localZ) * ChunkSize + localX;
+    }
+
+    static int32_t toChunkCoord(int32_t blockCoord) {
+        // Floor division so negative block coordinates land in the chunk below zero
+        return blockCoord >= 0 ? blockCoord / ChunkSize : -((-blockCoord + ChunkSize - 1) / ChunkSize);
+    }
+};
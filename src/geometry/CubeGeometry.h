@@ -0,0 +1,35 @@
+#pragma once
+#include "../data/Vec.h"
+#include <array>
+#include <cmath>
+
+// Unit block cube in the same layout the CUBE model bakes to: x and z span -0.5..0.5
+// around the block position and y spans 0..1. Faces follow ModelNode::QuadNormal order
+// and use the corner winding of PrefabMesher::generateBoxFace.
+namespace CubeGeometry {
+	struct Corner {
+		float x, y, z;
+	};
+
+	struct Face {
+		std::array<Corner, 4> corners;
+		int normal[3];
+	};
+
+	constexpr std::array<Face, 6> Faces = { {
+		{ { { { 0.5f, 0.0f, 0.5f }, { -0.5f, 0.0f, 0.5f }, { -0.5f, 1.0f, 0.5f }, { 0.5f, 1.0f, 0.5f } } }, { 0, 0, 1 } },      // PlusZ
+		{ { { { -0.5f, 0.0f, -0.5f }, { 0.5f, 0.0f, -0.5f }, { 0.5f, 1.0f, -0.5f }, { -0.5f, 1.0f, -0.5f } } }, { 0, 0, -1 } }, // MinusZ
+		{ { { { 0.5f, 0.0f, -0.5f }, { 0.5f, 0.0f, 0.5f }, { 0.5f, 1.0f, 0.5f }, { 0.5f, 1.0f, -0.5f } } }, { 1, 0, 0 } },     // PlusX
+		{ { { { -0.5f, 0.0f, 0.5f }, { -0.5f, 0.0f, -0.5f }, { -0.5f, 1.0f, -0.5f }, { -0.5f, 1.0f, 0.5f } } }, { -1, 0, 0 } }, // MinusX
+		{ { { { -0.5f, 1.0f, -0.5f }, { 0.5f, 1.0f, -0.5f }, { 0.5f, 1.0f, 0.5f }, { -0.5f, 1.0f, 0.5f } } }, { 0, 1, 0 } },   // PlusY
+		{ { { { -0.5f, 0.0f, 0.5f }, { 0.5f, 0.0f, 0.5f }, { 0.5f, 0.0f, -0.5f }, { -0.5f, 0.0f, -0.5f } } }, { 0, -1, 0 } },  // MinusY
+	} };
+
+	// Index into Faces of the axis-aligned direction closest to a normal
+	inline int faceFromNormal(const Vec3& normal) {
+		float ax = std::abs(normal.x), ay = std::abs(normal.y), az = std::abs(normal.z);
+		if (ax >= ay && ax >= az) return normal.x >= 0 ? 2 : 3;
+		if (ay >= az) return normal.y >= 0 ? 4 : 5;
+		return normal.z >= 0 ? 0 : 1;
+	}
+}
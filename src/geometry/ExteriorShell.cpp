@@ -0,0 +1,202 @@
+#include "ExteriorShell.h"
+#include "CubeGeometry.h"
+#include "../data/Model.h"
+#include "../util/Parallel.h"
+#include <cmath>
+
+void ExteriorShell::build(const Prefab& prefab, const BlockPalette& palette,
+    const std::vector<bool>& solid, bool dropBottom) {
+    Vec3 minBounds = prefab.getMinBounds();
+    Vec3 maxBounds = prefab.getMaxBounds();
+
+    originX = static_cast<int32_t>(std::lround(minBounds.x)) - 1;
+    originY = static_cast<int32_t>(std::lround(minBounds.y)) - 1;
+    originZ = static_cast<int32_t>(std::lround(minBounds.z)) - 1;
+    sizeX = static_cast<int32_t>(std::lround(maxBounds.x)) + 2 - originX;
+    sizeY = static_cast<int32_t>(std::lround(maxBounds.y)) + 2 - originY;
+    sizeZ = static_cast<int32_t>(std::lround(maxBounds.z)) + 2 - originZ;
+    tilesX = (sizeX + TileSize - 1) / TileSize;
+    tilesY = (sizeY + TileSize - 1) / TileSize;
+    tilesZ = (sizeZ + TileSize - 1) / TileSize;
+    bottomY = originY + 1;
+    this->dropBottom = dropBottom;
+
+    // Cells past the padded bounds in the last row of tiles are closed off so the
+    // fill stays inside the grid
+    const size_t tileCount = static_cast<size_t>(tilesX) * tilesY * tilesZ;
+    tiles.assign(tileCount, std::vector<uint8_t>());
+    Parallel::forEach(tileCount, [&](size_t tile) {
+        int32_t baseX = static_cast<int32_t>(tile % tilesX) * TileSize;
+        int32_t baseZ = static_cast<int32_t>((tile / tilesX) % tilesZ) * TileSize;
+        int32_t baseY = static_cast<int32_t>(tile / (static_cast<size_t>(tilesX) * tilesZ)) * TileSize;
+
+        std::vector<uint8_t>& cells = tiles[tile];
+        cells.assign(static_cast<size_t>(TileSize) * TileSize * TileSize, Open);
+        for (int32_t y = 0; y < TileSize; ++y) {
+            for (int32_t z = 0; z < TileSize; ++z) {
+                for (int32_t x = 0; x < TileSize; ++x) {
+                    if (baseX + x >= sizeX || baseY + y >= sizeY || baseZ + z >= sizeZ) {
+                        cells[ChunkPartitioner::voxelIndex(x, y, z)] = Solid;
+                    }
+                }
+            }
+        }
+    });
+
+    for (size_t i = 0; i < prefab.getBlocks().size(); ++i) {
+        uint16_t id = palette.blockIds[i];
+        if (id == BlockPalette::Empty || id >= solid.size() || !solid[id]) continue;
+
+        const PrefabBlock& block = prefab.getBlocks()[i];
+        int32_t gridX = block.x - originX, gridY = block.y - originY, gridZ = block.z - originZ;
+        tiles[tileIndex(gridX / TileSize, gridY / TileSize, gridZ / TileSize)]
+            [ChunkPartitioner::voxelIndex(gridX % TileSize, gridY % TileSize, gridZ % TileSize)] = Solid;
+    }
+
+    // The padding layer wraps the whole prefab, so filling from one corner of it
+    // reaches every outside cell. Each round fills tiles independently from the cells
+    // their neighbours reached in the previous round, until no tile gains new cells.
+    std::vector<std::vector<uint32_t>> seeds(tileCount);
+    seeds[0].push_back(static_cast<uint32_t>(ChunkPartitioner::voxelIndex(0, 0, 0)));
+
+    bool pending = true;
+    while (pending) {
+        Parallel::forEach(tileCount, [&](size_t tile) {
+            fillTile(tile, seeds[tile]);
+        });
+
+        Parallel::forEach(tileCount, [&](size_t tile) {
+            collectSeeds(tile, seeds[tile]);
+        });
+
+        pending = false;
+        for (const auto& tileSeeds : seeds) {
+            if (!tileSeeds.empty()) {
+                pending = true;
+                break;
+            }
+        }
+    }
+
+    reachableCount = 0;
+    enclosedCount = 0;
+    for (const auto& cells : tiles) {
+        for (uint8_t cell : cells) {
+            if (cell == Reached) reachableCount++;
+            else if (cell == Open) enclosedCount++;
+        }
+    }
+}
+
+void ExteriorShell::collectSeeds(size_t tile, std::vector<uint32_t>& seeds) const {
+    seeds.clear();
+
+    const int32_t tileX = static_cast<int32_t>(tile % tilesX);
+    const int32_t tileZ = static_cast<int32_t>((tile / tilesX) % tilesZ);
+    const int32_t tileY = static_cast<int32_t>(tile / (static_cast<size_t>(tilesX) * tilesZ));
+    const std::vector<uint8_t>& cells = tiles[tile];
+    constexpr int32_t Last = TileSize - 1;
+
+    // Open cells on each side of the tile whose neighbour across the border was reached
+    auto checkSide = [&](int32_t neighbourX, int32_t neighbourY, int32_t neighbourZ, int axis, int32_t layer) {
+        if (neighbourX < 0 || neighbourX >= tilesX || neighbourY < 0 || neighbourY >= tilesY ||
+            neighbourZ < 0 || neighbourZ >= tilesZ) {
+            return;
+        }
+
+        const std::vector<uint8_t>& neighbour = tiles[tileIndex(neighbourX, neighbourY, neighbourZ)];
+        const int32_t neighbourLayer = Last - layer;
+        for (int32_t a = 0; a < TileSize; ++a) {
+            for (int32_t b = 0; b < TileSize; ++b) {
+                size_t own, other;
+                if (axis == 0) {
+                    own = ChunkPartitioner::voxelIndex(layer, a, b);
+                    other = ChunkPartitioner::voxelIndex(neighbourLayer, a, b);
+                }
+                else if (axis == 1) {
+                    own = ChunkPartitioner::voxelIndex(a, layer, b);
+                    other = ChunkPartitioner::voxelIndex(a, neighbourLayer, b);
+                }
+                else {
+                    own = ChunkPartitioner::voxelIndex(a, b, layer);
+                    other = ChunkPartitioner::voxelIndex(a, b, neighbourLayer);
+                }
+                if (cells[own] == Open && neighbour[other] == Reached) {
+                    seeds.push_back(static_cast<uint32_t>(own));
+                }
+            }
+        }
+    };
+
+    checkSide(tileX - 1, tileY, tileZ, 0, 0);
+    checkSide(tileX + 1, tileY, tileZ, 0, Last);
+    checkSide(tileX, tileY - 1, tileZ, 1, 0);
+    checkSide(tileX, tileY + 1, tileZ, 1, Last);
+    checkSide(tileX, tileY, tileZ - 1, 2, 0);
+    checkSide(tileX, tileY, tileZ + 1, 2, Last);
+}
+
+void ExteriorShell::fillTile(size_t tile, std::vector<uint32_t>& seeds) {
+    std::vector<uint8_t>& cells = tiles[tile];
+    std::vector<uint32_t>& stack = seeds;
+
+    for (uint32_t seed : seeds) {
+        cells[seed] = Reached;
+    }
+
+    constexpr uint32_t Row = TileSize;
+    constexpr uint32_t Layer = TileSize * TileSize;
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+
+        uint32_t x = index % TileSize;
+        uint32_t z = (index / Row) % TileSize;
+        uint32_t y = index / Layer;
+
+        auto visit = [&](uint32_t neighbour) {
+            if (cells[neighbour] == Open) {
+                cells[neighbour] = Reached;
+                stack.push_back(neighbour);
+            }
+        };
+
+        if (x > 0) visit(index - 1);
+        if (x < TileSize - 1) visit(index + 1);
+        if (z > 0) visit(index - Row);
+        if (z < TileSize - 1) visit(index + Row);
+        if (y > 0) visit(index - Layer);
+        if (y < TileSize - 1) visit(index + Layer);
+    }
+}
+
+uint8_t ExteriorShell::getCell(int32_t gridX, int32_t gridY, int32_t gridZ) const {
+    if (gridX < 0 || gridY < 0 || gridZ < 0 || gridX >= sizeX || gridY >= sizeY || gridZ >= sizeZ) {
+        return Reached;
+    }
+    return tiles[tileIndex(gridX / TileSize, gridY / TileSize, gridZ / TileSize)]
+        [ChunkPartitioner::voxelIndex(gridX % TileSize, gridY % TileSize, gridZ % TileSize)];
+}
+
+bool ExteriorShell::isReachable(int32_t x, int32_t y, int32_t z) const {
+    return getCell(x - originX, y - originY, z - originZ) == Reached;
+}
+
+bool ExteriorShell::isEnclosed(int32_t x, int32_t y, int32_t z) const {
+    return getCell(x - originX, y - originY, z - originZ) == Open;
+}
+
+uint8_t ExteriorShell::getVisibleFaces(int32_t x, int32_t y, int32_t z) const {
+    uint8_t mask = 0;
+    for (int face = 0; face < 6; ++face) {
+        const int* normal = CubeGeometry::Faces[face].normal;
+        if (isReachable(x + normal[0], y + normal[1], z + normal[2])) {
+            mask |= static_cast<uint8_t>(1 << face);
+        }
+    }
+
+    if (dropBottom && y == bottomY) {
+        mask &= static_cast<uint8_t>(~(1 << static_cast<int>(ModelNode::QuadNormal::MinusY)));
+    }
+    return mask;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "../data/Prefab.h"
+#include "ChunkPartitioner.h"
+#include <cstdint>
+#include <vector>
+
+// Marks the empty space reachable from outside a prefab by flood filling from its
+// bounding box, padded by one block. Faces next to cells the fill never reaches, such
+// as sealed rooms and caves, can never be seen and are left out of the mesh.
+class ExteriorShell {
+public:
+    static constexpr uint8_t AllFaces = 0x3F;
+
+    // solid holds one flag per palette id for blocks that fully block air and sight.
+    // With dropBottom, faces pointing down out of the lowest layer are treated as hidden.
+    void build(const Prefab& prefab, const BlockPalette& palette,
+        const std::vector<bool>& solid, bool dropBottom);
+
+    // Cells outside the padded bounds count as reachable
+    bool isReachable(int32_t x, int32_t y, int32_t z) const;
+
+    // Non-solid cell the fill never reached, anything placed there is hidden
+    bool isEnclosed(int32_t x, int32_t y, int32_t z) const;
+
+    // Bit per CubeGeometry face whose neighbouring cell is reachable
+    uint8_t getVisibleFaces(int32_t x, int32_t y, int32_t z) const;
+
+    size_t getReachableCount() const { return reachableCount; }
+    size_t getEnclosedCount() const { return enclosedCount; }
+
+private:
+    enum CellState : uint8_t {
+        Open = 0,
+        Solid = 1,
+        Reached = 2
+    };
+
+    static constexpr int32_t TileSize = ChunkPartitioner::ChunkSize;
+
+    int32_t originX = 0, originY = 0, originZ = 0; // Grid cell 0, one below the prefab minimum
+    int32_t sizeX = 0, sizeY = 0, sizeZ = 0;
+    int32_t tilesX = 0, tilesY = 0, tilesZ = 0;
+    int32_t bottomY = 0;
+    bool dropBottom = false;
+    std::vector<std::vector<uint8_t>> tiles; // TileSize^3 cells each, indexed by ChunkPartitioner::voxelIndex
+    size_t reachableCount = 0;
+    size_t enclosedCount = 0;
+
+    size_t tileIndex(int32_t tileX, int32_t tileY, int32_t tileZ) const {
+        return (static_cast<size_t>(tileY) * tilesZ + tileZ) * tilesX + tileX;
+    }
+
+    uint8_t getCell(int32_t gridX, int32_t gridY, int32_t gridZ) const;
+    void collectSeeds(size_t tile, std::vector<uint32_t>& seeds) const;
+    void fillTile(size_t tile, std::vector<uint32_t>& seeds);
+};
@@ -0,0 +1,220 @@
+#include "LODMesher.h"
+#include "CubeGeometry.h"
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+LODMesher::LODMesher(PrefabMesher* prefabMesher, ModelRegistry* modelRegistry, TextureRegistry* textureRegistry)
+    : prefabMesher(prefabMesher), modelRegistry(modelRegistry), textureRegistry(textureRegistry) {
+}
+
+void LODMesher::prepare(const BlockPalette& palette) {
+    appearances.clear();
+    appearances.resize(palette.names.size());
+
+    for (size_t id = 0; id < palette.names.size(); ++id) {
+        if (id == BlockPalette::Empty) continue;
+
+        const std::string& blockName = palette.names[id];
+        Model* model = modelRegistry->getModel(blockName);
+        if (!model || model->nodeCount == 0) continue;
+
+        CubeAppearance& appearance = appearances[id];
+        const Mesh& modelTemplate = prefabMesher->getModelTemplate(*model);
+        if (modelTemplate.faces.empty()) continue;
+
+        if (model->isCube) {
+            // Faces keep their template material, so each side keeps its own texture
+            appearance.cube = modelTemplate;
+            appearance.materials = modelTemplate.materials;
+            uint16_t fallback = static_cast<uint16_t>(appearance.materials.size());
+            bool usesFallback = false;
+            for (auto& face : appearance.cube.faces) {
+                if (face.material == MeshFace::NoMaterial || face.material >= fallback) {
+                    face.material = fallback;
+                    usesFallback = true;
+                }
+            }
+            if (usesFallback) {
+                appearance.materials.push_back({ .name = modelTemplate.materialName });
+            }
+        }
+        else {
+            buildColorCube(appearance, blockName);
+        }
+
+        for (const auto& face : appearance.cube.faces) {
+            appearance.faceDirections.push_back(
+                CubeGeometry::faceFromNormal(appearance.cube.vertices[face.indices[0]].normal));
+        }
+        appearance.solid = true;
+    }
+}
+
+void LODMesher::buildColorCube(CubeAppearance& appearance, const std::string& blockName) {
+    Vec3 color(0.5f, 0.5f, 0.5f);
+    std::string texturePath = modelRegistry->findTexturePath(blockName);
+    if (!texturePath.empty() && texturePath != "EMPTY") {
+        textureRegistry->getAverageColor(texturePath, color);
+    }
+
+    appearance.materials = { { .name = "lod_" + blockName, .diffuse = color, .textured = false } };
+
+    Mesh& cube = appearance.cube;
+    for (const auto& face : CubeGeometry::Faces) {
+        MeshFace meshFace;
+        for (int i = 0; i < 4; ++i) {
+            Vertex v;
+            v.position = Vec3(face.corners[i].x, face.corners[i].y, face.corners[i].z);
+            v.normal = Vec3(static_cast<float>(face.normal[0]), static_cast<float>(face.normal[1]),
+                static_cast<float>(face.normal[2]));
+            meshFace.indices[i] = cube.addVertex(v);
+        }
+        meshFace.vertexCount = 4;
+        meshFace.material = 0;
+        cube.addFace(meshFace);
+    }
+}
+
+void LODMesher::buildLevel(const Prefab& prefab, const BlockPalette& palette, int level) {
+    constexpr int32_t ChunkSize = ChunkPartitioner::ChunkSize;
+    factor = 1 << level;
+    chunks.clear();
+    cellIds.clear();
+    if (prefab.getBlocks().empty()) return;
+
+    Vec3 minBounds = prefab.getMinBounds();
+    Vec3 size = prefab.getSize();
+    originX = static_cast<int32_t>(minBounds.x);
+    originY = static_cast<int32_t>(minBounds.y);
+    originZ = static_cast<int32_t>(minBounds.z);
+    const int32_t sizeX = static_cast<int32_t>(size.x);
+    const int32_t sizeY = static_cast<int32_t>(size.y);
+    const int32_t sizeZ = static_cast<int32_t>(size.z);
+
+    // (cell, block type) of every solid block, sorted so each cell is one run and each
+    // type one run inside it
+    std::vector<std::pair<uint64_t, uint16_t>> samples;
+    samples.reserve(prefab.getBlocks().size());
+    for (size_t i = 0; i < prefab.getBlocks().size(); ++i) {
+        uint16_t id = palette.blockIds[i];
+        if (!appearances[id].solid) continue;
+
+        const PrefabBlock& block = prefab.getBlocks()[i];
+        samples.emplace_back(cellKey((block.x - originX) / factor, (block.y - originY) / factor,
+            (block.z - originZ) / factor), id);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    // Cells on the far sides of the prefab are cut off by its bounds, so only the blocks
+    // inside them count towards the half
+    auto cellSpan = [this](int32_t cell, int32_t size) {
+        return std::min(factor, size - cell * factor);
+    };
+
+    std::vector<Cell> cells;
+    Cell fullest{};
+    size_t fullestCount = 0;
+    for (size_t i = 0; i < samples.size();) {
+        uint64_t key = samples[i].first;
+        size_t end = i;
+        uint16_t majority = samples[i].second;
+        size_t bestRun = 0;
+        while (end < samples.size() && samples[end].first == key) {
+            size_t run = end;
+            while (run < samples.size() && samples[run].first == key && samples[run].second == samples[end].second) ++run;
+            if (run - end > bestRun) {
+                bestRun = run - end;
+                majority = samples[end].second;
+            }
+            end = run;
+        }
+
+        Cell cell{
+            static_cast<int32_t>(key & 0x1FFFFF),
+            static_cast<int32_t>(key >> 42),
+            static_cast<int32_t>((key >> 21) & 0x1FFFFF),
+            majority
+        };
+        size_t count = end - i;
+        size_t blocksInside = static_cast<size_t>(cellSpan(cell.x, sizeX)) * cellSpan(cell.y, sizeY) * cellSpan(cell.z, sizeZ);
+        if (count * 2 >= blocksInside) {
+            cells.push_back(cell);
+        }
+        if (count > fullestCount) {
+            fullestCount = count;
+            fullest = cell;
+        }
+        i = end;
+    }
+
+    // Keep the fullest cell rather than letting a small or sparse prefab vanish
+    if (cells.empty() && fullestCount > 0) {
+        cells.push_back(fullest);
+    }
+
+    // Group cells by ChunkSize^3 block region, ordered by region X, then Z, then Y
+    const int32_t cellsPerChunk = ChunkSize / factor;
+    auto region = [cellsPerChunk](const Cell& cell) {
+        return std::make_tuple(cell.x / cellsPerChunk, cell.z / cellsPerChunk, cell.y / cellsPerChunk);
+    };
+    std::sort(cells.begin(), cells.end(), [&](const Cell& a, const Cell& b) {
+        return std::make_tuple(region(a), a.y, a.z, a.x) < std::make_tuple(region(b), b.y, b.z, b.x);
+    });
+
+    cellIds.reserve(cells.size());
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const Cell& cell = cells[i];
+        cellIds.emplace(cellKey(cell.x, cell.y, cell.z), cell.id);
+        if (i == 0 || region(cell) != region(cells[i - 1])) {
+            chunks.emplace_back();
+        }
+        chunks.back().push_back(cell);
+    }
+}
+
+void LODMesher::generateChunkLOD(size_t chunkIndex, Mesh& outputMesh) const {
+    auto isSolid = [&](int32_t x, int32_t y, int32_t z) {
+        if (x < 0 || y < 0 || z < 0) return false;
+        return cellIds.count(cellKey(x, y, z)) != 0;
+    };
+
+    // Output material per palette id and template material, filled as they are used
+    std::vector<std::vector<int32_t>> outputMaterials(appearances.size());
+    const float scale = static_cast<float>(factor);
+    const float centerOffset = 0.5f * scale - 0.5f;
+
+    for (const Cell& cell : chunks[chunkIndex]) {
+        const CubeAppearance& appearance = appearances[cell.id];
+        std::vector<int32_t>& materials = outputMaterials[cell.id];
+        if (materials.empty()) {
+            materials.assign(appearance.materials.size(), -1);
+        }
+
+        // Scale the unit cube so it spans the factor^3 blocks of the cell
+        Vec3 origin(
+            static_cast<float>(originX + cell.x * factor) + centerOffset,
+            static_cast<float>(originY + cell.y * factor),
+            static_cast<float>(originZ + cell.z * factor) + centerOffset);
+
+        for (size_t faceIdx = 0; faceIdx < appearance.cube.faces.size(); ++faceIdx) {
+            const int* normal = CubeGeometry::Faces[appearance.faceDirections[faceIdx]].normal;
+            if (isSolid(cell.x + normal[0], cell.y + normal[1], cell.z + normal[2])) continue;
+
+            const MeshFace& face = appearance.cube.faces[faceIdx];
+            if (materials[face.material] < 0) {
+                materials[face.material] = outputMesh.getOrAddMaterial(appearance.materials[face.material]);
+            }
+
+            MeshFace outputFace;
+            outputFace.vertexCount = face.vertexCount;
+            outputFace.material = static_cast<uint16_t>(materials[face.material]);
+            for (uint8_t i = 0; i < face.vertexCount; ++i) {
+                Vertex v = appearance.cube.vertices[face.indices[i]];
+                v.position = v.position * scale + origin;
+                outputFace.indices[i] = outputMesh.addVertex(v);
+            }
+            outputMesh.addFace(outputFace);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "../data/Prefab.h"
+#include "../data/MeshData.h"
+#include "../data/Model.h"
+#include "ChunkPartitioner.h"
+#include "PrefabMesher.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Builds voxel-downsampled meshes where each cell of 2^level blocks becomes one cube.
+// Cells are aligned to the prefab's lowest corner and span the whole prefab, so faces
+// between cells are culled across chunk borders too.
+class LODMesher {
+public:
+    static constexpr int MaxLevel = 3;
+
+    LODMesher(PrefabMesher* prefabMesher, ModelRegistry* modelRegistry, TextureRegistry* textureRegistry);
+
+    // Resolves the coarse cube of every palette entry. Cube blocks keep their faces,
+    // materials and atlas UVs, custom models become a cube in the average colour of
+    // their texture.
+    void prepare(const BlockPalette& palette);
+
+    // Downsamples the whole prefab for one level. A cell is solid when at least half of
+    // its blocks inside the prefab bounds are, and takes the most common block type
+    // among them. A non-empty prefab always keeps at least one cell.
+    void buildLevel(const Prefab& prefab, const BlockPalette& palette, int level);
+
+    // Solid cells are grouped into ChunkSize^3 block regions for meshing
+    size_t getChunkCount() const { return chunks.size(); }
+
+    // Safe to call from several threads once buildLevel() has run
+    void generateChunkLOD(size_t chunkIndex, Mesh& outputMesh) const;
+
+private:
+    struct CubeAppearance {
+        bool solid = false;
+        Mesh cube; // Unit cube in CubeGeometry layout, faces index into materials
+        std::vector<MeshMaterial> materials;
+        std::vector<int> faceDirections; // CubeGeometry face index per cube face
+    };
+
+    struct Cell {
+        int32_t x, y, z; // In cells from the prefab's lowest corner
+        uint16_t id;
+    };
+
+    PrefabMesher* prefabMesher;
+    ModelRegistry* modelRegistry;
+    TextureRegistry* textureRegistry;
+    std::vector<CubeAppearance> appearances;
+
+    // Of the level last built
+    int32_t factor = 1;
+    int32_t originX = 0, originY = 0, originZ = 0;
+    std::vector<std::vector<Cell>> chunks;
+    std::unordered_map<uint64_t, uint16_t> cellIds; // Solid cells by cellKey
+
+    void buildColorCube(CubeAppearance& appearance, const std::string& blockName);
+
+    static uint64_t cellKey(int32_t x, int32_t y, int32_t z) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 42) |
+            (static_cast<uint64_t>(static_cast<uint32_t>(z)) << 21) | static_cast<uint32_t>(x);
+    }
+};
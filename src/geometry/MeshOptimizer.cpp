@@ -0,0 +1,609 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+    std::vector<MaterialRange> getRanges(const Mesh& mesh) {
+        if (!mesh.materialRanges.empty() || mesh.faces.empty()) {
+            return mesh.materialRanges;
+        }
+        return { { .material = MeshFace::NoMaterial, .firstFace = 0,
+            .faceCount = static_cast<uint32_t>(mesh.faces.size()) } };
+    }
+
+    // Triangles an importer makes out of the face
+    uint32_t triangleCount(const MeshFace& face) {
+        return face.vertexCount >= 3 ? face.vertexCount - 2u : 0u;
+    }
+
+    // FIFO cache with timestamps, a vertex is a hit while fewer than CacheSize
+    // misses have happened since it was loaded
+    struct FifoCache {
+        std::vector<uint32_t> timestamps;
+        uint32_t time = MeshOptimizer::CacheSize + 1;
+
+        explicit FifoCache(size_t vertexCount) : timestamps(vertexCount, 0) {}
+
+        // Every vertex misses again after this
+        void flush() {
+            time += MeshOptimizer::CacheSize + 1;
+        }
+
+        bool access(uint32_t vertex) {
+            if (time - timestamps[vertex] > MeshOptimizer::CacheSize) {
+                timestamps[vertex] = time++;
+                return false;
+            }
+            return true;
+        }
+    };
+
+    struct VertexKey {
+        std::array<uint32_t, 8> bits;
+
+        explicit VertexKey(const Vertex& v) : bits{
+            std::bit_cast<uint32_t>(v.position.x), std::bit_cast<uint32_t>(v.position.y),
+            std::bit_cast<uint32_t>(v.position.z), std::bit_cast<uint32_t>(v.uv.u),
+            std::bit_cast<uint32_t>(v.uv.v), std::bit_cast<uint32_t>(v.normal.x),
+            std::bit_cast<uint32_t>(v.normal.y), std::bit_cast<uint32_t>(v.normal.z) } {}
+
+        bool operator==(const VertexKey& other) const { return bits == other.bits; }
+    };
+
+    // Plane or edge of a quad on a grid of PositionEpsilon-sized steps
+    using GridKey = std::array<int64_t, 7>;
+
+    struct GridKeyHash {
+        size_t operator()(const GridKey& key) const {
+            uint64_t hash = 14695981039346656037ull;
+            for (int64_t word : key) {
+                hash = (hash ^ static_cast<uint64_t>(word)) * 1099511628211ull;
+            }
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            uint64_t hash = 14695981039346656037ull;
+            for (uint32_t word : key.bits) {
+                hash = (hash ^ word) * 1099511628211ull;
+            }
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    // Forsyth's scoring: the last face's vertices get a flat score so the next face
+    // doesn't simply reuse them, older cache entries decay, and vertices with few
+    // faces left get a boost so they are finished off before dropping out
+    constexpr float LastFaceScore = 0.75f;
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+    constexpr int32_t LastFaceSize = 3;
+
+    float vertexScore(int32_t cachePosition, uint32_t remainingFaces) {
+        if (remainingFaces == 0) return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < LastFaceSize) {
+                score = LastFaceScore;
+            }
+            else {
+                const float scale = 1.0f / (MeshOptimizer::CacheSize - LastFaceSize);
+                score = std::pow(1.0f - (cachePosition - LastFaceSize) * scale, CacheDecayPower);
+            }
+        }
+        return score + ValenceBoostScale * std::pow(static_cast<float>(remainingFaces), -ValenceBoostPower);
+    }
+}
+
+void MeshOptimizer::mergeCoplanarQuads(Mesh& mesh) {
+    constexpr float PositionEpsilon = 1e-5f;
+    constexpr float UVEpsilon = 1e-5f;
+
+    auto position = [&](uint32_t index) -> const Vec3& { return mesh.vertices[index].position; };
+    auto dot = [](const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+    auto crossLength = [](const Vec3& a, const Vec3& b) {
+        Vec3 c(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+        return std::sqrt(c.x * c.x + c.y * c.y + c.z * c.z);
+    };
+    auto samePosition = [&](uint32_t a, uint32_t b) {
+        Vec3 d = position(a) - position(b);
+        return std::abs(d.x) <= PositionEpsilon && std::abs(d.y) <= PositionEpsilon && std::abs(d.z) <= PositionEpsilon;
+    };
+    // b lies on the segment from a to c
+    auto isBetween = [&](uint32_t a, uint32_t b, uint32_t c) {
+        Vec3 ab = position(b) - position(a);
+        Vec3 bc = position(c) - position(b);
+        return crossLength(ab, bc) <= PositionEpsilon && dot(ab, bc) > 0.0f;
+    };
+
+    // Materials are named per model node, so quads are compared by how their materials
+    // render rather than by id
+    std::vector<uint16_t> appearances(mesh.materials.size());
+    for (size_t m = 0; m < mesh.materials.size(); ++m) {
+        const MeshMaterial& material = mesh.materials[m];
+        appearances[m] = static_cast<uint16_t>(m);
+        for (size_t n = 0; n < m; ++n) {
+            const MeshMaterial& other = mesh.materials[n];
+            if (material.textured == other.textured && material.atlasPage == other.atlasPage &&
+                material.diffuse.x == other.diffuse.x && material.diffuse.y == other.diffuse.y &&
+                material.diffuse.z == other.diffuse.z) {
+                appearances[m] = appearances[n];
+                break;
+            }
+        }
+    }
+    auto appearance = [&](uint16_t material) {
+        return material == MeshFace::NoMaterial ? material : appearances[material];
+    };
+
+    auto tryMerge = [&](MeshFace& first, const MeshFace& second) {
+        if (appearance(first.material) != appearance(second.material)) return false;
+
+        const Vec3& normal = mesh.vertices[first.indices[0]].normal;
+        for (int i = 0; i < 4; ++i) {
+            Vec3 n0 = mesh.vertices[first.indices[i]].normal - normal;
+            Vec3 n1 = mesh.vertices[second.indices[i]].normal - normal;
+            if (dot(n0, n0) > PositionEpsilon || dot(n1, n1) > PositionEpsilon) return false;
+        }
+
+        for (int k = 0; k < 4; ++k) {
+            // first is (a, b, c, d) and second runs the shared edge backwards as (c, b, g, h)
+            uint32_t a = first.indices[(k + 3) % 4], b = first.indices[k];
+            uint32_t c = first.indices[(k + 1) % 4], d = first.indices[(k + 2) % 4];
+
+            for (int m = 0; m < 4; ++m) {
+                if (!samePosition(second.indices[m], c) || !samePosition(second.indices[(m + 1) % 4], b)) continue;
+
+                uint32_t g = second.indices[(m + 2) % 4], h = second.indices[(m + 3) % 4];
+                if (!isBetween(a, b, g) || !isBetween(h, c, d)) return false;
+
+                // UVs of the second quad must follow the first quad's affine mapping
+                Vec3 e1 = position(b) - position(a);
+                Vec3 e2 = position(d) - position(a);
+                float g11 = dot(e1, e1), g12 = dot(e1, e2), g22 = dot(e2, e2);
+                float det = g11 * g22 - g12 * g12;
+                if (std::abs(det) < 1e-12f) return false;
+
+                const Vec2& uvA = mesh.vertices[a].uv;
+                Vec2 du = mesh.vertices[b].uv - uvA;
+                Vec2 dv = mesh.vertices[d].uv - uvA;
+                for (int i = 0; i < 4; ++i) {
+                    const Vertex& vertex = mesh.vertices[second.indices[i]];
+                    Vec3 p = vertex.position - position(a);
+                    float r1 = dot(p, e1), r2 = dot(p, e2);
+                    float s = (r1 * g22 - r2 * g12) / det;
+                    float t = (r2 * g11 - r1 * g12) / det;
+                    if (std::abs(dot(p, p) - (s * s * g11 + 2 * s * t * g12 + t * t * g22)) > PositionEpsilon) {
+                        return false; // Off the plane
+                    }
+                    Vec2 expected(uvA.u + s * du.u + t * dv.u, uvA.v + s * du.v + t * dv.v);
+                    if (std::abs(expected.u - vertex.uv.u) > UVEpsilon || std::abs(expected.v - vertex.uv.v) > UVEpsilon) {
+                        return false;
+                    }
+                }
+
+                first.indices[0] = a;
+                first.indices[1] = g;
+                first.indices[2] = h;
+                first.indices[3] = d;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Quads are bucketed by plane and appearance, and a quad's merge candidates are the
+    // quads in its bucket that run one of its edges the other way
+    auto grid = [](float value) { return static_cast<int64_t>(std::llround(value / PositionEpsilon)); };
+    std::unordered_map<GridKey, uint32_t, GridKeyHash> planes;
+    std::vector<uint32_t> planeOf(mesh.faces.size(), 0);
+    for (uint32_t f = 0; f < mesh.faces.size(); ++f) {
+        const MeshFace& face = mesh.faces[f];
+        if (face.vertexCount != 4) continue;
+        const Vec3& normal = mesh.vertices[face.indices[0]].normal;
+        GridKey key = { appearance(face.material), std::llround(normal.x * 1024.0f), std::llround(normal.y * 1024.0f),
+            std::llround(normal.z * 1024.0f), grid(dot(normal, position(face.indices[0]))), 0, 0 };
+        planeOf[f] = planes.try_emplace(key, static_cast<uint32_t>(planes.size())).first->second;
+    }
+
+    std::unordered_map<GridKey, uint32_t, GridKeyHash> edges;
+    auto edgeKey = [&](uint32_t face, uint32_t from, uint32_t to) {
+        const Vec3& a = position(from);
+        const Vec3& b = position(to);
+        return GridKey{ planeOf[face], grid(a.x), grid(a.y), grid(a.z), grid(b.x), grid(b.y), grid(b.z) };
+    };
+    auto linkEdges = [&](uint32_t face, bool link) {
+        const MeshFace& quad = mesh.faces[face];
+        for (int k = 0; k < 4; ++k) {
+            GridKey key = edgeKey(face, quad.indices[k], quad.indices[(k + 1) % 4]);
+            if (link) {
+                edges[key] = face;
+                continue;
+            }
+            auto it = edges.find(key);
+            if (it != edges.end() && it->second == face) edges.erase(it);
+        }
+    };
+
+    std::vector<uint32_t> pending;
+    for (uint32_t f = 0; f < mesh.faces.size(); ++f) {
+        if (mesh.faces[f].vertexCount != 4) continue;
+        linkEdges(f, true);
+        pending.push_back(f);
+    }
+
+    // A merged quad goes back on the list, since its new edges may meet further quads
+    std::vector<bool> removed(mesh.faces.size(), false);
+    while (!pending.empty()) {
+        uint32_t face = pending.back();
+        pending.pop_back();
+        if (removed[face]) continue;
+
+        for (int k = 0; k < 4; ++k) {
+            const MeshFace& quad = mesh.faces[face];
+            auto it = edges.find(edgeKey(face, quad.indices[(k + 1) % 4], quad.indices[k]));
+            if (it == edges.end() || it->second == face || removed[it->second]) continue;
+
+            uint32_t other = it->second;
+            MeshFace merged = quad;
+            if (!tryMerge(merged, mesh.faces[other])) continue;
+
+            linkEdges(face, false);
+            linkEdges(other, false);
+            removed[other] = true;
+            mesh.faces[face] = merged;
+            linkEdges(face, true);
+            pending.push_back(face);
+            break;
+        }
+    }
+
+    if (std::find(removed.begin(), removed.end(), true) == removed.end()) return;
+
+    std::vector<MeshFace> kept;
+    kept.reserve(mesh.faces.size());
+    for (size_t i = 0; i < mesh.faces.size(); ++i) {
+        if (!removed[i]) kept.push_back(mesh.faces[i]);
+    }
+    mesh.faces.swap(kept);
+    mesh.materialRanges.clear();
+    optimizeVertexFetch(mesh);
+}
+
+void MeshOptimizer::triangulate(Mesh& mesh) {
+    std::vector<MaterialRange> ranges = getRanges(mesh);
+
+    std::vector<MeshFace> triangles;
+    triangles.reserve(mesh.faces.size() * 2);
+    for (auto& range : ranges) {
+        uint32_t first = static_cast<uint32_t>(triangles.size());
+        for (uint32_t i = range.firstFace; i < range.firstFace + range.faceCount; ++i) {
+            const MeshFace& face = mesh.faces[i];
+            if (face.vertexCount != 4) {
+                triangles.push_back(face);
+                continue;
+            }
+
+            // Later passes only remap the first vertexCount indices, so clear the stale one
+            MeshFace lower = face;
+            lower.vertexCount = 3;
+            lower.indices[3] = 0;
+            MeshFace upper = lower;
+            upper.indices[1] = face.indices[2];
+            upper.indices[2] = face.indices[3];
+            triangles.push_back(lower);
+            triangles.push_back(upper);
+        }
+        range.firstFace = first;
+        range.faceCount = static_cast<uint32_t>(triangles.size()) - first;
+    }
+
+    mesh.faces.swap(triangles);
+    if (!mesh.materialRanges.empty()) {
+        mesh.materialRanges = ranges;
+    }
+}
+
+void MeshOptimizer::weldVertices(Mesh& mesh) {
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+    unique.reserve(mesh.vertices.size());
+
+    std::vector<uint32_t> remap(mesh.vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        auto result = unique.emplace(VertexKey(mesh.vertices[i]), static_cast<uint32_t>(welded.size()));
+        if (result.second) {
+            welded.push_back(mesh.vertices[i]);
+        }
+        remap[i] = result.first->second;
+    }
+
+    for (auto& face : mesh.faces) {
+        for (uint8_t i = 0; i < face.vertexCount; ++i) {
+            face.indices[i] = remap[face.indices[i]];
+        }
+    }
+    mesh.vertices.swap(welded);
+}
+
+void MeshOptimizer::optimizeVertexCache(Mesh& mesh) {
+    std::vector<MaterialRange> ranges = getRanges(mesh);
+
+    // Range-local vertex ids, reset after each range
+    std::vector<uint32_t> localIds(mesh.vertices.size(), UINT32_MAX);
+    std::vector<uint32_t> globalIds;
+    std::vector<uint32_t> remaining;
+    std::vector<uint32_t> adjacencyStart;
+    std::vector<uint32_t> adjacency;
+    std::vector<int32_t> cachePositions;
+    std::vector<float> vertexScores;
+    std::vector<bool> emitted;
+    std::vector<MeshFace> ordered;
+    std::vector<uint32_t> cache, nextCache;
+
+    for (const auto& range : ranges) {
+        const MeshFace* faces = mesh.faces.data() + range.firstFace;
+        const uint32_t faceCount = range.faceCount;
+        if (faceCount < 2) continue;
+
+        globalIds.clear();
+        for (uint32_t f = 0; f < faceCount; ++f) {
+            for (uint8_t i = 0; i < faces[f].vertexCount; ++i) {
+                uint32_t vertex = faces[f].indices[i];
+                if (localIds[vertex] == UINT32_MAX) {
+                    localIds[vertex] = static_cast<uint32_t>(globalIds.size());
+                    globalIds.push_back(vertex);
+                }
+            }
+        }
+        const size_t vertexCount = globalIds.size();
+
+        // Faces per vertex as one flat list, live entries are the first remaining[v]
+        remaining.assign(vertexCount, 0);
+        for (uint32_t f = 0; f < faceCount; ++f) {
+            for (uint8_t i = 0; i < faces[f].vertexCount; ++i) {
+                remaining[localIds[faces[f].indices[i]]]++;
+            }
+        }
+        adjacencyStart.assign(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+        }
+        adjacency.resize(adjacencyStart[vertexCount]);
+        std::fill(remaining.begin(), remaining.end(), 0);
+        for (uint32_t f = 0; f < faceCount; ++f) {
+            for (uint8_t i = 0; i < faces[f].vertexCount; ++i) {
+                uint32_t v = localIds[faces[f].indices[i]];
+                adjacency[adjacencyStart[v] + remaining[v]++] = f;
+            }
+        }
+
+        cachePositions.assign(vertexCount, -1);
+        vertexScores.resize(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+        }
+        emitted.assign(faceCount, false);
+        ordered.clear();
+        cache.clear();
+
+        uint32_t cursor = 0;
+        int64_t bestFace = -1;
+        while (ordered.size() < faceCount) {
+            if (bestFace < 0) {
+                // Dead end, restart from the next face in input order
+                while (emitted[cursor]) cursor++;
+                bestFace = cursor;
+            }
+
+            const MeshFace& face = faces[bestFace];
+            emitted[bestFace] = true;
+            ordered.push_back(face);
+
+            nextCache.clear();
+            for (uint8_t i = 0; i < face.vertexCount; ++i) {
+                uint32_t v = localIds[face.indices[i]];
+                uint32_t* list = adjacency.data() + adjacencyStart[v];
+                uint32_t* last = list + remaining[v] - 1;
+                std::iter_swap(std::find(list, last + 1, static_cast<uint32_t>(bestFace)), last);
+                remaining[v]--;
+
+                if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+                    nextCache.push_back(v);
+                }
+            }
+            for (uint32_t v : cache) {
+                if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+                    nextCache.push_back(v);
+                }
+            }
+
+            for (size_t i = CacheSize; i < nextCache.size(); ++i) {
+                uint32_t v = nextCache[i];
+                cachePositions[v] = -1;
+                vertexScores[v] = vertexScore(-1, remaining[v]);
+            }
+            if (nextCache.size() > CacheSize) {
+                nextCache.resize(CacheSize);
+            }
+            cache.swap(nextCache);
+
+            // Rescore everything touching the cache and pick the best face among them
+            for (size_t i = 0; i < cache.size(); ++i) {
+                uint32_t v = cache[i];
+                cachePositions[v] = static_cast<int32_t>(i);
+                vertexScores[v] = vertexScore(cachePositions[v], remaining[v]);
+            }
+
+            bestFace = -1;
+            float bestScore = -1.0f;
+            for (uint32_t v : cache) {
+                const uint32_t* list = adjacency.data() + adjacencyStart[v];
+                for (uint32_t a = 0; a < remaining[v]; ++a) {
+                    uint32_t f = list[a];
+                    float score = 0.0f;
+                    for (uint8_t i = 0; i < faces[f].vertexCount; ++i) {
+                        score += vertexScores[localIds[faces[f].indices[i]]];
+                    }
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestFace = f;
+                    }
+                }
+            }
+        }
+
+        std::copy(ordered.begin(), ordered.end(), mesh.faces.begin() + range.firstFace);
+        for (uint32_t vertex : globalIds) {
+            localIds[vertex] = UINT32_MAX;
+        }
+    }
+}
+
+void MeshOptimizer::optimizeOverdraw(Mesh& mesh, float threshold) {
+    struct Cluster {
+        uint32_t firstFace;
+        uint32_t faceCount;
+        float sortKey;
+    };
+
+    auto faceArea = [&](const MeshFace& face) {
+        float area = 0.0f;
+        const Vec3& p0 = mesh.vertices[face.indices[0]].position;
+        for (uint8_t i = 2; i < face.vertexCount; ++i) {
+            Vec3 e1 = mesh.vertices[face.indices[i - 1]].position - p0;
+            Vec3 e2 = mesh.vertices[face.indices[i]].position - p0;
+            Vec3 cross(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+            area += 0.5f * std::sqrt(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+        }
+        return area;
+    };
+    auto faceCentroid = [&](const MeshFace& face) {
+        Vec3 centroid(0, 0, 0);
+        for (uint8_t i = 0; i < face.vertexCount; ++i) {
+            centroid += mesh.vertices[face.indices[i]].position;
+        }
+        return centroid * (1.0f / face.vertexCount);
+    };
+
+    // Clusters are sorted by how far they face out from the mesh centre
+    Vec3 center(0, 0, 0);
+    float totalArea = 0.0f;
+    for (const auto& face : mesh.faces) {
+        float area = faceArea(face);
+        center += faceCentroid(face) * area;
+        totalArea += area;
+    }
+    if (totalArea <= 0.0f) return;
+    center = center * (1.0f / totalArea);
+
+    std::vector<Cluster> clusters;
+    std::vector<MeshFace> sorted;
+    FifoCache fifo(mesh.vertices.size());
+    for (const auto& range : getRanges(mesh)) {
+        const MeshFace* faces = mesh.faces.data() + range.firstFace;
+
+        // A face that misses on every vertex starts a cluster, moving whole clusters
+        // around only costs the cache at those boundaries
+        clusters.clear();
+        fifo.flush();
+        VertexCacheStats before;
+        for (uint32_t f = 0; f < range.faceCount; ++f) {
+            uint32_t misses = 0;
+            for (uint8_t i = 0; i < faces[f].vertexCount; ++i) {
+                misses += fifo.access(faces[f].indices[i]) ? 0 : 1;
+            }
+            before.misses += misses;
+            before.triangles += triangleCount(faces[f]);
+
+            if (clusters.empty() || misses == faces[f].vertexCount) {
+                clusters.push_back({ f, 0, 0.0f });
+            }
+            clusters.back().faceCount++;
+        }
+        if (clusters.size() < 2) continue;
+
+        for (auto& cluster : clusters) {
+            Vec3 centroid(0, 0, 0);
+            Vec3 normal(0, 0, 0);
+            float area = 0.0f;
+            for (uint32_t f = cluster.firstFace; f < cluster.firstFace + cluster.faceCount; ++f) {
+                float faceSize = faceArea(faces[f]);
+                centroid += faceCentroid(faces[f]) * faceSize;
+                for (uint8_t i = 0; i < faces[f].vertexCount; ++i) {
+                    normal += mesh.vertices[faces[f].indices[i]].normal * faceSize;
+                }
+                area += faceSize;
+            }
+            if (area <= 0.0f) continue;
+
+            centroid = centroid * (1.0f / area);
+            float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+            if (length <= 0.0f) continue;
+
+            Vec3 offset = centroid - center;
+            cluster.sortKey = (offset.x * normal.x + offset.y * normal.y + offset.z * normal.z) / length;
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+            return a.sortKey > b.sortKey;
+        });
+
+        sorted.clear();
+        for (const auto& cluster : clusters) {
+            sorted.insert(sorted.end(), faces + cluster.firstFace, faces + cluster.firstFace + cluster.faceCount);
+        }
+
+        fifo.flush();
+        VertexCacheStats after;
+        for (const auto& face : sorted) {
+            for (uint8_t i = 0; i < face.vertexCount; ++i) {
+                after.misses += fifo.access(face.indices[i]) ? 0 : 1;
+            }
+            after.triangles += triangleCount(face);
+        }
+
+        if (after.getACMR() <= before.getACMR() * threshold) {
+            std::copy(sorted.begin(), sorted.end(), mesh.faces.begin() + range.firstFace);
+        }
+    }
+}
+
+void MeshOptimizer::optimizeVertexFetch(Mesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+
+    for (auto& face : mesh.faces) {
+        for (uint8_t i = 0; i < face.vertexCount; ++i) {
+            uint32_t& index = remap[face.indices[i]];
+            if (index == UINT32_MAX) {
+                index = static_cast<uint32_t>(ordered.size());
+                ordered.push_back(mesh.vertices[face.indices[i]]);
+            }
+            face.indices[i] = index;
+        }
+    }
+    mesh.vertices.swap(ordered);
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const Mesh& mesh) {
+    VertexCacheStats stats;
+    FifoCache fifo(mesh.vertices.size());
+    for (const auto& face : mesh.faces) {
+        // Importers fan quads from vertex 0, which only revisits cached vertices
+        for (uint8_t i = 0; i < face.vertexCount; ++i) {
+            stats.misses += fifo.access(face.indices[i]) ? 0 : 1;
+        }
+        stats.triangles += triangleCount(face);
+    }
+    return stats;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../data/MeshData.h"
+#include <cstdint>
+
+// Post-transform vertex cache behaviour of a face order, counted per triangle
+struct VertexCacheStats {
+    uint64_t triangles = 0;
+    uint64_t misses = 0;
+
+    // Average cache miss ratio, vertices transformed per triangle (0.5 at best, 3 at worst)
+    double getACMR() const {
+        return triangles == 0 ? 0.0 : static_cast<double>(misses) / static_cast<double>(triangles);
+    }
+
+    void add(const VertexCacheStats& other) {
+        triangles += other.triangles;
+        misses += other.misses;
+    }
+};
+
+// Index post-passes run on finished meshes. Faces are only ever reordered inside
+// their material range, so meshes must already be sorted with Mesh::sortFacesByMaterial.
+class MeshOptimizer {
+public:
+    static constexpr uint32_t CacheSize = 32;
+
+    // Merges pairs of quads that share a whole edge into one, when both lie in one plane
+    // with the same material and normals and map positions to UVs with the same affine
+    // transform, so the merged quad samples exactly the texels the pair did. Drops
+    // material ranges, so the mesh needs sorting again afterwards.
+    static void mergeCoplanarQuads(Mesh& mesh);
+
+    // Splits quads into two triangles along their 0-2 diagonal
+    static void triangulate(Mesh& mesh);
+
+    // Merges bit-identical vertices so faces can share them through the cache
+    static void weldVertices(Mesh& mesh);
+
+    // Forsyth's linear-speed ordering: greedily emits the face whose vertices score
+    // best against a simulated LRU cache and their remaining face count
+    static void optimizeVertexCache(Mesh& mesh);
+
+    // Sander et al.'s cluster sort: splits the cache-optimized order where the cache
+    // runs dry and moves outward-facing clusters first, so fewer hidden pixels are shaded.
+    // A range keeps its previous order when the ACMR would grow by more than threshold.
+    static void optimizeOverdraw(Mesh& mesh, float threshold = 1.05f);
+
+    // Renumbers vertices in order of first use and drops unreferenced ones
+    static void optimizeVertexFetch(Mesh& mesh);
+
+    // FIFO cache simulation of the current face order
+    static VertexCacheStats analyzeVertexCache(const Mesh& mesh);
+};
@@ -0,0 +1,348 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+    // Symmetric 4x4 error quadric, sum of squared distances to a set of planes
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0, c = 0;
+
+        void addPlane(const Vec3& normal, double distance, double weight) {
+            double x = normal.x, y = normal.y, z = normal.z;
+            a00 += weight * x * x; a01 += weight * x * y; a02 += weight * x * z;
+            a11 += weight * y * y; a12 += weight * y * z; a22 += weight * z * z;
+            b0 += weight * x * distance; b1 += weight * y * distance; b2 += weight * z * distance;
+            c += weight * distance * distance;
+        }
+
+        void add(const Quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+        }
+
+        double evaluate(const Vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z
+                + a11 * y * y + 2 * a12 * y * z + a22 * z * z
+                + 2 * (b0 * x + b1 * y + b2 * z) + c;
+            return std::max(result, 0.0);
+        }
+    };
+
+    // Keeps vertices on a seam or border close to it while sliding along
+    constexpr double BoundaryWeight = 10.0;
+
+    enum class VertexKind : uint8_t {
+        Free,        // Inside one UV island
+        Constrained, // On exactly one seam or border, two boundary edges
+        Locked
+    };
+
+    struct Edge {
+        uint32_t triangles[2];
+        uint32_t triangleCount = 0;
+        bool boundary = false;
+    };
+
+    struct Collapse {
+        uint32_t from, to;
+        double cost;
+    };
+
+    Vec3 cross(const Vec3& a, const Vec3& b) {
+        return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    float dot(const Vec3& a, const Vec3& b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    uint64_t edgeKey(uint32_t a, uint32_t b) {
+        return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+    }
+}
+
+uint32_t MeshSimplifier::simplify(Mesh& mesh, uint32_t targetTriangles, float maxError) {
+    uint32_t triangleCount = 0;
+    for (const auto& face : mesh.faces) {
+        triangleCount += face.vertexCount >= 3 ? face.vertexCount - 2u : 0u;
+    }
+    if (triangleCount <= targetTriangles) return triangleCount;
+
+    // Worked on a copy so a mesh where nothing can collapse keeps its quads
+    Mesh work = mesh;
+    MeshOptimizer::triangulate(work);
+    MeshOptimizer::weldVertices(work);
+
+    std::vector<MeshFace>& triangles = work.faces;
+    uint32_t aliveCount = static_cast<uint32_t>(triangles.size());
+
+    // Topology works on welded positions, attributes stay on the mesh vertices
+    std::vector<Vec3> positions;
+    std::vector<uint32_t> positionOf(work.vertices.size());
+    {
+        std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+        for (size_t i = 0; i < work.vertices.size(); ++i) {
+            const Vec3& p = work.vertices[i].position;
+            uint64_t hash = std::bit_cast<uint32_t>(p.x) * 73856093ull ^
+                std::bit_cast<uint32_t>(p.y) * 19349663ull ^ std::bit_cast<uint32_t>(p.z) * 83492791ull;
+
+            std::vector<uint32_t>& bucket = buckets[hash];
+            auto found = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t id) {
+                return positions[id].x == p.x && positions[id].y == p.y && positions[id].z == p.z;
+            });
+            if (found == bucket.end()) {
+                bucket.push_back(static_cast<uint32_t>(positions.size()));
+                positionOf[i] = static_cast<uint32_t>(positions.size());
+                positions.push_back(p);
+            }
+            else {
+                positionOf[i] = *found;
+            }
+        }
+    }
+
+    auto cornerPosition = [&](uint32_t triangle, int corner) {
+        return positionOf[triangles[triangle].indices[corner]];
+    };
+    auto cornerOf = [&](uint32_t triangle, uint32_t position) {
+        for (int i = 0; i < 3; ++i) {
+            if (cornerPosition(triangle, i) == position) return i;
+        }
+        return -1;
+    };
+
+    auto triangleNormal = [&](uint32_t triangle) {
+        const Vec3& p0 = positions[cornerPosition(triangle, 0)];
+        return cross(positions[cornerPosition(triangle, 1)] - p0, positions[cornerPosition(triangle, 2)] - p0).normalize();
+    };
+
+    std::vector<bool> alive(triangles.size(), true);
+    std::vector<Quadric> quadrics(positions.size());
+    for (uint32_t t = 0; t < triangles.size(); ++t) {
+        const Vec3& p0 = positions[cornerPosition(t, 0)];
+        Vec3 normal = cross(positions[cornerPosition(t, 1)] - p0, positions[cornerPosition(t, 2)] - p0);
+        if (dot(normal, normal) < 1e-12f) continue;
+
+        normal = normal.normalize();
+        for (int i = 0; i < 3; ++i) {
+            quadrics[cornerPosition(t, i)].addPlane(normal, -dot(normal, p0), 1.0);
+        }
+    }
+
+    const double maxCost = static_cast<double>(maxError) * maxError;
+    std::vector<std::vector<uint32_t>> trianglesAt(positions.size());
+    std::unordered_map<uint64_t, Edge> edges;
+    std::vector<uint8_t> boundaryCount(positions.size());
+    std::vector<VertexKind> kinds(positions.size());
+    std::vector<Collapse> collapses;
+    std::vector<bool> touched(positions.size());
+    std::unordered_map<uint32_t, uint32_t> vertexMap;
+    std::vector<uint32_t> neighboursFrom, neighboursTo, shared;
+    bool boundaryQuadricsAdded = false;
+
+    while (aliveCount > targetTriangles) {
+        for (auto& list : trianglesAt) list.clear();
+        edges.clear();
+        for (uint32_t t = 0; t < triangles.size(); ++t) {
+            if (!alive[t]) continue;
+            for (int i = 0; i < 3; ++i) {
+                trianglesAt[cornerPosition(t, i)].push_back(t);
+
+                Edge& edge = edges[edgeKey(cornerPosition(t, i), cornerPosition(t, (i + 1) % 3))];
+                if (edge.triangleCount < 2) edge.triangles[edge.triangleCount] = t;
+                edge.triangleCount++;
+            }
+        }
+
+        // An edge is a boundary when it is open, non-manifold, folds back on itself as
+        // the rim of a double-sided quad does, or the two sides use different vertices
+        // or materials at either end
+        std::fill(boundaryCount.begin(), boundaryCount.end(), 0);
+        for (auto& pair : edges) {
+            Edge& edge = pair.second;
+            uint32_t a = static_cast<uint32_t>(pair.first >> 32);
+            uint32_t b = static_cast<uint32_t>(pair.first & 0xFFFFFFFF);
+
+            if (edge.triangleCount != 2) {
+                edge.boundary = true;
+            }
+            else {
+                const MeshFace& t0 = triangles[edge.triangles[0]];
+                const MeshFace& t1 = triangles[edge.triangles[1]];
+                edge.boundary = dot(triangleNormal(edge.triangles[0]), triangleNormal(edge.triangles[1])) < -0.99f ||
+                    t0.material != t1.material ||
+                    t0.indices[cornerOf(edge.triangles[0], a)] != t1.indices[cornerOf(edge.triangles[1], a)] ||
+                    t0.indices[cornerOf(edge.triangles[0], b)] != t1.indices[cornerOf(edge.triangles[1], b)];
+            }
+
+            if (edge.boundary) {
+                boundaryCount[a] = static_cast<uint8_t>(std::min(boundaryCount[a] + 1, 255));
+                boundaryCount[b] = static_cast<uint8_t>(std::min(boundaryCount[b] + 1, 255));
+
+                // Planes through each boundary edge, perpendicular to its triangle
+                if (!boundaryQuadricsAdded) {
+                    const Vec3& p0 = positions[cornerPosition(edge.triangles[0], 0)];
+                    Vec3 faceNormal = cross(positions[cornerPosition(edge.triangles[0], 1)] - p0,
+                        positions[cornerPosition(edge.triangles[0], 2)] - p0);
+                    Vec3 normal = cross(positions[b] - positions[a], faceNormal);
+                    if (dot(normal, normal) >= 1e-12f) {
+                        normal = normal.normalize();
+                        double distance = -dot(normal, positions[a]);
+                        quadrics[a].addPlane(normal, distance, BoundaryWeight);
+                        quadrics[b].addPlane(normal, distance, BoundaryWeight);
+                    }
+                }
+            }
+        }
+        boundaryQuadricsAdded = true;
+
+        for (size_t p = 0; p < positions.size(); ++p) {
+            kinds[p] = boundaryCount[p] == 0 ? VertexKind::Free :
+                (boundaryCount[p] == 2 ? VertexKind::Constrained : VertexKind::Locked);
+        }
+
+        collapses.clear();
+        for (const auto& pair : edges) {
+            uint32_t a = static_cast<uint32_t>(pair.first >> 32);
+            uint32_t b = static_cast<uint32_t>(pair.first & 0xFFFFFFFF);
+            auto canMove = [&](uint32_t from) {
+                return kinds[from] == VertexKind::Free ||
+                    (kinds[from] == VertexKind::Constrained && pair.second.boundary);
+            };
+
+            Quadric combined = quadrics[a];
+            combined.add(quadrics[b]);
+            double costToB = canMove(a) ? combined.evaluate(positions[b]) : -1.0;
+            double costToA = canMove(b) ? combined.evaluate(positions[a]) : -1.0;
+
+            if (costToB >= 0 && (costToA < 0 || costToB <= costToA)) {
+                collapses.push_back({ a, b, costToB });
+            }
+            else if (costToA >= 0) {
+                collapses.push_back({ b, a, costToA });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost < y.cost || (x.cost == y.cost && x.from < y.from);
+        });
+
+        // Independent collapses are applied in one pass, anything next to a collapse
+        // waits for the next pass when adjacency is rebuilt
+        std::fill(touched.begin(), touched.end(), false);
+        uint32_t applied = 0;
+        for (const auto& collapse : collapses) {
+            if (collapse.cost > maxCost || aliveCount <= targetTriangles) break;
+
+            const uint32_t from = collapse.from, to = collapse.to;
+            if (touched[from] || touched[to]) continue;
+
+            // Link condition: the only shared neighbours are the tips of the edge's triangles
+            auto gatherNeighbours = [&](uint32_t position, std::vector<uint32_t>& out) {
+                out.clear();
+                for (uint32_t t : trianglesAt[position]) {
+                    for (int i = 0; i < 3; ++i) {
+                        uint32_t other = cornerPosition(t, i);
+                        if (other != position) out.push_back(other);
+                    }
+                }
+                std::sort(out.begin(), out.end());
+                out.erase(std::unique(out.begin(), out.end()), out.end());
+            };
+            gatherNeighbours(from, neighboursFrom);
+            gatherNeighbours(to, neighboursTo);
+            shared.clear();
+            std::set_intersection(neighboursFrom.begin(), neighboursFrom.end(),
+                neighboursTo.begin(), neighboursTo.end(), std::back_inserter(shared));
+
+            uint32_t edgeTriangles = 0;
+            for (uint32_t t : trianglesAt[from]) {
+                if (cornerOf(t, to) >= 0) edgeTriangles++;
+            }
+            if (shared.size() != edgeTriangles) continue;
+
+            // Each vertex at the moving position maps to the one its triangle uses at the
+            // target, which only exists for vertices that share a triangle with it
+            vertexMap.clear();
+            bool valid = true;
+            for (uint32_t t : trianglesAt[from]) {
+                int toCorner = cornerOf(t, to);
+                if (toCorner < 0) continue;
+                uint32_t vertex = triangles[t].indices[cornerOf(t, from)];
+                auto result = vertexMap.emplace(vertex, triangles[t].indices[toCorner]);
+                if (!result.second && result.first->second != triangles[t].indices[toCorner]) {
+                    valid = false;
+                }
+            }
+
+            // Surviving triangles must keep their facing
+            for (uint32_t t : trianglesAt[from]) {
+                if (!valid) break;
+                if (cornerOf(t, to) >= 0) continue;
+
+                int corner = cornerOf(t, from);
+                if (vertexMap.find(triangles[t].indices[corner]) == vertexMap.end()) {
+                    valid = false;
+                    break;
+                }
+
+                Vec3 p[3];
+                for (int i = 0; i < 3; ++i) {
+                    p[i] = positions[cornerPosition(t, i)];
+                }
+                Vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+                p[corner] = positions[to];
+                Vec3 after = cross(p[1] - p[0], p[2] - p[0]);
+                if (dot(before, after) <= 0.0f) valid = false;
+            }
+            if (!valid) continue;
+
+            for (uint32_t t : trianglesAt[from]) {
+                for (int i = 0; i < 3; ++i) {
+                    touched[cornerPosition(t, i)] = true;
+                }
+            }
+            for (uint32_t t : trianglesAt[to]) {
+                for (int i = 0; i < 3; ++i) {
+                    touched[cornerPosition(t, i)] = true;
+                }
+            }
+
+            for (uint32_t t : trianglesAt[from]) {
+                if (cornerOf(t, to) >= 0) {
+                    alive[t] = false;
+                    aliveCount--;
+                    continue;
+                }
+                uint32_t& index = triangles[t].indices[cornerOf(t, from)];
+                index = vertexMap[index];
+            }
+            quadrics[to].add(quadrics[from]);
+            applied++;
+        }
+
+        if (applied == 0) break;
+    }
+
+    if (aliveCount == triangles.size()) return triangleCount;
+
+    std::vector<MeshFace> remaining;
+    remaining.reserve(aliveCount);
+    for (uint32_t t = 0; t < triangles.size(); ++t) {
+        if (alive[t]) remaining.push_back(triangles[t]);
+    }
+    triangles.swap(remaining);
+    MeshOptimizer::optimizeVertexFetch(work);
+
+    if (!work.materialRanges.empty()) {
+        work.sortFacesByMaterial();
+    }
+    mesh = std::move(work);
+    return aliveCount;
+}
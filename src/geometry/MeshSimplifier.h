@@ -0,0 +1,21 @@
+#pragma once
+#include "../data/MeshData.h"
+#include <cstdint>
+
+// Quadric error metric edge collapse (Garland & Heckbert) for baked model templates.
+// Vertices sharing a position are welded for topology while their UV and normal
+// variants are kept apart, so collapses never tear a UV seam or a material boundary:
+//  - vertices inside one UV island may collapse along any edge
+//  - vertices on exactly one seam or open border may only slide along it
+//  - corners where seams or borders meet stay where they are
+// Collapses move a vertex onto a neighbour, so no new attribute values are invented.
+class MeshSimplifier {
+public:
+    // Largest distance a surface may move, one model pixel
+    static constexpr float DefaultMaxError = 1.0f / 32.0f;
+
+    // Collapses edges until at most targetTriangles remain or the next collapse would
+    // exceed maxError, leaving the mesh triangulated. Meshes already within budget are
+    // left untouched. Returns the triangle count.
+    static uint32_t simplify(Mesh& mesh, uint32_t targetTriangles, float maxError = DefaultMaxError);
+};
@@ -0,0 +1,140 @@
+#include "MeshletBuilder.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void MeshletBuilder::build(const Mesh& mesh, MeshletData& output, unsigned int maxThreads) {
+    output.clear();
+
+    std::vector<MaterialRange> ranges = mesh.materialRanges;
+    if (ranges.empty() && !mesh.faces.empty()) {
+        ranges.push_back({ .material = MeshFace::NoMaterial, .firstFace = 0,
+            .faceCount = static_cast<uint32_t>(mesh.faces.size()) });
+    }
+
+    std::vector<MeshletData> rangeData(ranges.size());
+    Parallel::forEach(ranges.size(), [&](size_t i) {
+        buildRange(mesh, ranges[i].firstFace, ranges[i].faceCount, rangeData[i]);
+    }, maxThreads);
+
+    for (const auto& data : rangeData) {
+        uint32_t vertexBase = static_cast<uint32_t>(output.vertices.size());
+        uint32_t triangleBase = static_cast<uint32_t>(output.triangles.size() / 3);
+        for (Meshlet meshlet : data.meshlets) {
+            meshlet.vertexOffset += vertexBase;
+            meshlet.triangleOffset += triangleBase;
+            output.meshlets.push_back(meshlet);
+        }
+        output.vertices.insert(output.vertices.end(), data.vertices.begin(), data.vertices.end());
+        output.triangles.insert(output.triangles.end(), data.triangles.begin(), data.triangles.end());
+    }
+}
+
+void MeshletBuilder::buildRange(const Mesh& mesh, uint32_t firstFace, uint32_t faceCount, MeshletData& output) {
+    Meshlet current{};
+
+    auto startMeshlet = [&](uint32_t face) {
+        current = Meshlet{};
+        current.firstFace = face;
+        current.vertexOffset = static_cast<uint32_t>(output.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(output.triangles.size() / 3);
+    };
+
+    auto finishMeshlet = [&]() {
+        if (current.triangleCount == 0) return;
+        computeBounds(mesh, output, current);
+        output.meshlets.push_back(current);
+    };
+
+    startMeshlet(firstFace);
+    for (uint32_t f = firstFace; f < firstFace + faceCount; ++f) {
+        const MeshFace& face = mesh.faces[f];
+        if (face.vertexCount != 3) {
+            throw std::runtime_error("Meshlets need a triangulated mesh");
+        }
+
+        // Meshlet-local slot of each corner, or the number of new vertices it needs
+        const uint32_t* meshletVertices = output.vertices.data() + current.vertexOffset;
+        uint8_t slots[3];
+        uint32_t newVertices = 0;
+        for (int i = 0; i < 3; ++i) {
+            const uint32_t* end = meshletVertices + current.vertexCount;
+            const uint32_t* found = std::find(meshletVertices, end, face.indices[i]);
+            bool repeated = false;
+            for (int j = 0; j < i; ++j) {
+                repeated |= face.indices[j] == face.indices[i];
+            }
+            if (found == end && !repeated) newVertices++;
+        }
+
+        if (current.vertexCount + newVertices > MaxVertices || current.triangleCount + 1 > MaxTriangles) {
+            finishMeshlet();
+            startMeshlet(f);
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            const uint32_t* begin = output.vertices.data() + current.vertexOffset;
+            const uint32_t* end = begin + current.vertexCount;
+            const uint32_t* found = std::find(begin, end, face.indices[i]);
+            if (found == end) {
+                output.vertices.push_back(face.indices[i]);
+                slots[i] = static_cast<uint8_t>(current.vertexCount++);
+            }
+            else {
+                slots[i] = static_cast<uint8_t>(found - begin);
+            }
+        }
+        output.triangles.insert(output.triangles.end(), slots, slots + 3);
+        current.triangleCount++;
+    }
+    finishMeshlet();
+}
+
+void MeshletBuilder::computeBounds(const Mesh& mesh, const MeshletData& data, Meshlet& meshlet) {
+    // Sphere around the centre of the vertex bounding box
+    Vec3 minPos = mesh.vertices[data.vertices[meshlet.vertexOffset]].position;
+    Vec3 maxPos = minPos;
+    for (uint32_t i = 1; i < meshlet.vertexCount; ++i) {
+        const Vec3& p = mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+        minPos = Vec3(std::min(minPos.x, p.x), std::min(minPos.y, p.y), std::min(minPos.z, p.z));
+        maxPos = Vec3(std::max(maxPos.x, p.x), std::max(maxPos.y, p.y), std::max(maxPos.z, p.z));
+    }
+    meshlet.center = (minPos + maxPos) * 0.5f;
+
+    float radiusSq = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+        Vec3 d = mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position - meshlet.center;
+        radiusSq = std::max(radiusSq, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+    meshlet.radius = std::sqrt(radiusSq);
+
+    // Triangle facing comes from the vertex normals, which unlike the winding are
+    // consistent across box and quad nodes
+    std::vector<Vec3> normals(meshlet.triangleCount);
+    Vec3 axis(0, 0, 0);
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+        const uint8_t* corners = &data.triangles[(meshlet.triangleOffset + t) * 3];
+        Vec3 n(0, 0, 0);
+        for (int i = 0; i < 3; ++i) {
+            n += mesh.vertices[data.vertices[meshlet.vertexOffset + corners[i]]].normal;
+        }
+        float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        normals[t] = length > 0.0f ? n * (1.0f / length) : Vec3(0, 0, 0);
+        axis += normals[t];
+    }
+
+    float axisLength = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    if (axisLength < 1e-6f) {
+        meshlet.coneAxis = Vec3(0, 0, 1);
+        meshlet.coneCutoff = -1.0f;
+        return;
+    }
+    meshlet.coneAxis = axis * (1.0f / axisLength);
+
+    float cutoff = 1.0f;
+    for (const Vec3& n : normals) {
+        cutoff = std::min(cutoff, n.x * meshlet.coneAxis.x + n.y * meshlet.coneAxis.y + n.z * meshlet.coneAxis.z);
+    }
+    meshlet.coneCutoff = cutoff <= 0.0f ? -1.0f : cutoff;
+}
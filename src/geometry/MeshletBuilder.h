@@ -0,0 +1,49 @@
+#pragma once
+#include "../data/MeshData.h"
+#include "../data/Vec.h"
+#include <cstdint>
+#include <vector>
+
+// Cluster of up to MeshletBuilder::MaxTriangles triangles over at most MaxVertices
+// vertices. Its triangles are a contiguous run of the mesh's faces within one material.
+struct Meshlet {
+    uint32_t firstFace;
+    uint32_t vertexOffset;   // Into MeshletData::vertices
+    uint32_t vertexCount;
+    uint32_t triangleOffset; // Into MeshletData::triangles, in triangles
+    uint32_t triangleCount;
+
+    Vec3 center;
+    float radius;
+    // Every triangle normal is within acos(coneCutoff) of coneAxis, -1 when the
+    // triangles face too many ways to cull the cluster
+    Vec3 coneAxis;
+    float coneCutoff;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices; // Mesh vertex index per meshlet vertex
+    std::vector<uint8_t> triangles; // Three meshlet-local vertex indices per triangle
+
+    void clear() {
+        meshlets.clear();
+        vertices.clear();
+        triangles.clear();
+    }
+};
+
+class MeshletBuilder {
+public:
+    static constexpr uint32_t MaxVertices = 64;
+    static constexpr uint32_t MaxTriangles = 124;
+
+    // Splits a triangulated mesh sorted by material into meshlets, scanning faces in
+    // order so a cache-optimized order carries over. Material ranges run in parallel on
+    // up to maxThreads threads, 0 for all cores and 1 when already on a worker thread.
+    static void build(const Mesh& mesh, MeshletData& output, unsigned int maxThreads = 0);
+
+private:
+    static void buildRange(const Mesh& mesh, uint32_t firstFace, uint32_t faceCount, MeshletData& output);
+    static void computeBounds(const Mesh& mesh, const MeshletData& data, Meshlet& meshlet);
+};
@@ -26,6 +26,8 @@ Model* ModelRegistry::loadModel(const std::string& modelName) {
     Model* model = new Model();
 
     if (modelPath == "CUBE") {
+        model->isCube = true;
+
         ModelNode node;
         node.nameId = nodeNameManager.getOrAddNameId("Cube");
         node.position = Vec3(0, 0, 0);
@@ -53,111 +55,32 @@ Model* ModelRegistry::loadModel(const std::string& modelName) {
 
     std::string texturePath = findTexturePath(modelName);
     if (!texturePath.empty() && texturePath != "EMPTY") {
-        const AtlasRegion* region = textureRegistry->getTextureRegion(texturePath);
+        model->textureId = textureRegistry->getTextureId(texturePath);
+    }
 
-        if (region) {
-            float sourceTexWidth = static_cast<float>(region->pixelWidth);
-            float sourceTexHeight = static_cast<float>(region->pixelHeight);
+    models[modelName] = model;
+    return model;
+}
 
-            float atlasWidthInUV = region->uvMax.u - region->uvMin.u;
-            float atlasHeightInUV = region->uvMax.v - region->uvMin.v;
+void ModelRegistry::addUsedTexels() {
+    for (const auto& [modelName, model] : models) {
+        uint32_t textureWidth, textureHeight;
+        if (!textureRegistry->getTextureSize(model->textureId, textureWidth, textureHeight)) continue;
 
-            for (int i = 0; i < model->nodeCount; i++) {
-                ModelNode& node = model->allNodes[i];
+        for (int i = 0; i < model->nodeCount; i++) {
+            const ModelNode& node = model->allNodes[i];
+            if (!node.visible) continue;
 
-                std::string nodeName = "Unnamed";
-                if (node.nameId != -1) {
-                    nodeNameManager.tryGetNameFromId(node.nameId, nodeName);
-                }
+            for (size_t faceIdx = 0; faceIdx < node.textureLayout.size(); faceIdx++) {
+                if (node.textureLayout[faceIdx].hidden) continue;
 
-                for (size_t faceIdx = 0; faceIdx < node.textureLayout.size(); faceIdx++) {
-                    auto& layout = node.textureLayout[faceIdx];
-
-                    std::string faceName;
-                    Vec2 faceDimensions;
-
-                    if (node.type == ModelNode::ShapeType::Box) {
-                        switch (faceIdx) {
-                        case 0: // Front (-Z): width  height
-                            faceName = "Front (-Z)";
-                            faceDimensions = Vec2(node.size.x, node.size.y);
-                            faceDimensions.u *= node.stretch.x;  // width stretch
-                            faceDimensions.v *= node.stretch.y;  // height stretch
-                            break;
-                        case 1: // Back (+Z): width  height
-                            faceName = "Back (+Z)";
-                            faceDimensions = Vec2(node.size.x, node.size.y);
-                            faceDimensions.u *= node.stretch.x;  // width stretch
-                            faceDimensions.v *= node.stretch.y;  // height stretch
-                            break;
-                        case 2: // Right (+X): depth  height
-                            faceName = "Right (+X)";
-                            faceDimensions = Vec2(node.size.z, node.size.y);
-                            faceDimensions.u *= node.stretch.z;  // depth stretch
-                            faceDimensions.v *= node.stretch.y;  // height stretch
-                            break;
-                        case 3: // Left (-X): depth  height
-                            faceName = "Left (-X)";
-                            faceDimensions = Vec2(node.size.z, node.size.y);
-                            faceDimensions.u *= node.stretch.z;  // depth stretch
-                            faceDimensions.v *= node.stretch.y;  // height stretch
-                            break;
-                        case 4: // Top (+Y): width  depth
-                            faceName = "Top (+Y)";
-                            faceDimensions = Vec2(node.size.x, node.size.z);
-                            faceDimensions.u *= node.stretch.x;  // width stretch
-                            faceDimensions.v *= node.stretch.z;  // depth stretch
-                            break;
-                        case 5: // Bottom (-Y): width  depth
-                            faceName = "Bottom (-Y)";
-                            faceDimensions = Vec2(node.size.x, node.size.z);
-                            faceDimensions.u *= node.stretch.x;  // width stretch
-                            faceDimensions.v *= node.stretch.z;  // depth stretch
-                            break;
-                        default:
-                            faceName = "Unknown";
-                            faceDimensions = Vec2(node.size.x, node.size.y);
-                            break;
-                        }
-                    }
-                    else if (node.type == ModelNode::ShapeType::Quad) {
-                        faceName = "Quad";
-                        faceDimensions = Vec2(node.size.x, node.size.y);
-                        faceDimensions.u *= node.stretch.x;
-                        faceDimensions.v *= node.stretch.y;
-                    }
-                    else {
-                        faceName = "None";
-                        faceDimensions = Vec2(0, 0);
-                    }
-
-                    // Apply stretch multiplier
-                    Vec2 stretchedDimensions = faceDimensions;
-                    stretchedDimensions.u *= node.stretch.x;
-                    stretchedDimensions.v *= node.stretch.y;
-
-                    // Convert pixel offset to normalized UV in source texture
-                    float normalizedUMin = layout.offset.u / sourceTexWidth;
-                    float normalizedVMin = layout.offset.v / sourceTexHeight;
-                    float normalizedUMax = (layout.offset.u + faceDimensions.u) / sourceTexWidth;
-                    float normalizedVMax = (layout.offset.v + faceDimensions.v) / sourceTexHeight;
-
-                    // Transform to atlas space
-                    layout.uvMin.u = region->uvMin.u + (normalizedUMin * atlasWidthInUV);
-                    layout.uvMin.v = region->uvMin.v + (normalizedVMin * atlasHeightInUV);
-                    layout.uvMax.u = region->uvMin.u + (normalizedUMax * atlasWidthInUV);
-                    layout.uvMax.v = region->uvMin.v + (normalizedVMax * atlasHeightInUV);
-
-                    // Update offset to atlas space as well
-                    layout.offset.u = layout.uvMin.u;
-                    layout.offset.v = layout.uvMin.v;
+                TexelRect rect;
+                if (node.getFaceTexelRect(faceIdx, textureWidth, textureHeight, rect)) {
+                    textureRegistry->addUsedRect(model->textureId, rect);
                 }
             }
         }
     }
-
-    models[modelName] = model;
-    return model;
 }
 
 std::string ModelRegistry::findModelPath(const std::string& modelName) {
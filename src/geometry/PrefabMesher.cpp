@@ -1,42 +1,495 @@
 #include "PrefabMesher.h"
+#include "CubeGeometry.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <utility>
 
+// Which of uvMin and uvMax each face corner takes for every quarter turn and mirroring
+// of a texture, starting from (min, max), (max, max), (max, min), (min, min). Resolved
+// here once instead of swapping UVs per face.
+static constexpr auto buildFaceUVCorners() {
+    std::array<std::array<std::array<PrefabMesher::UVCorners, 2>, 2>, 4> table{};
+    for (int steps = 0; steps < 4; ++steps) {
+        for (int mirrorX = 0; mirrorX < 2; ++mirrorX) {
+            for (int mirrorY = 0; mirrorY < 2; ++mirrorY) {
+                bool u[4] = { false, true, true, false };
+                bool v[4] = { true, true, false, false };
+                for (int i = 0; i < steps; ++i) {
+                    bool tu = u[0], tv = v[0];
+                    u[0] = u[3]; v[0] = v[3];
+                    u[3] = u[2]; v[3] = v[2];
+                    u[2] = u[1]; v[2] = v[1];
+                    u[1] = tu; v[1] = tv;
+                }
+                if (mirrorX) {
+                    std::swap(u[0], u[1]);
+                    std::swap(u[2], u[3]);
+                }
+                if (mirrorY) {
+                    std::swap(v[0], v[3]);
+                    std::swap(v[1], v[2]);
+                }
+                for (int i = 0; i < 4; ++i) {
+                    table[steps][mirrorX][mirrorY].useMaxU[i] = u[i];
+                    table[steps][mirrorX][mirrorY].useMaxV[i] = v[i];
+                }
+            }
+        }
+    }
+    return table;
+}
+
+const std::array<std::array<std::array<PrefabMesher::UVCorners, 2>, 2>, 4> PrefabMesher::FaceUVCorners =
+    buildFaceUVCorners();
+
 PrefabMesher::PrefabMesher(ModelRegistry* registry, TextureRegistry* textureRegistry)
     : modelRegistry(registry), textureRegistry(textureRegistry) {
 }
 
 void PrefabMesher::generatePrefabMesh(const Prefab& prefab, Mesh& outputMesh) {
+    beginMesh(outputMesh);
+
+    // Chunk order rather than file order keeps the vertices of one region together
+    for (const auto& chunk : ChunkPartitioner::partition(prefab)) {
+        generateChunkMesh(prefab, chunk, outputMesh);
+    }
+
+    outputMesh.sortFacesByMaterial();
+}
+
+void PrefabMesher::beginMesh(Mesh& outputMesh) {
     outputMesh.clear();
+    for (auto& pair : templates) {
+        pair.second.outputMaterials.clear();
+        pair.second.outputFaces.clear();
+    }
+}
+
+void PrefabMesher::generateChunkMesh(const Prefab& prefab, const PrefabChunk& chunk, Mesh& outputMesh) {
+    for (uint32_t blockIndex : chunk.blockIndices) {
+        appendBlock(outputMesh, prefab.getBlocks()[blockIndex]);
+    }
+}
+
+void PrefabMesher::generateBlockMesh(const PrefabBlock& block, Mesh& outputMesh) {
+    appendBlock(outputMesh, block);
+}
+
+void PrefabMesher::setExteriorShell(const ExteriorShell* shell) {
+    exteriorShell = shell;
+}
+
+void PrefabMesher::setSimplification(uint32_t triangleBudget) {
+    simplifyBudget = triangleBudget;
+}
+
+void PrefabMesher::appendBlock(Mesh& outputMesh, const PrefabBlock& block) {
+    if (block.name == "Empty" || block.name.empty()) return;
+
+    if (block.name != cachedBlockName) {
+        cachedBlockName = block.name;
+        cachedModel = modelRegistry->getModel(block.name);
+        cachedTemplate = cachedModel && cachedModel->nodeCount > 0 ? &getTemplate(*cachedModel) : nullptr;
+    }
+    Model* model = cachedModel;
 
-    for (const auto& block : prefab.blocks) {
-        if (block.name == "Empty" || block.name.empty()) continue;
+    if (!cachedTemplate) return;
 
-        Model* model = modelRegistry->getModel(block.name);
+    uint8_t visibleFaces = ExteriorShell::AllFaces;
+    if (exteriorShell) {
+        if (exteriorShell->isEnclosed(block.x, block.y, block.z)) return;
+        visibleFaces = exteriorShell->getVisibleFaces(block.x, block.y, block.z);
+    }
 
-        if (!model || model->nodeCount == 0) continue;
+    ModelTemplate& modelTemplate = *cachedTemplate;
+    uint8_t orientation = BlockRotation::toOrientation(block.rotation);
+    if (model->isCube) {
+        const CubeFaces& cubeFaces = getCubeFaces(modelTemplate, orientation);
+        if (cubeFaces.valid) {
+            appendCube(outputMesh, modelTemplate, cubeFaces, block.x, block.y, block.z, visibleFaces);
+            return;
+        }
+    }
+    appendTemplate(outputMesh, modelTemplate, block.x, block.y, block.z, orientation, visibleFaces);
+}
+
+const Mesh& PrefabMesher::getModelTemplate(const Model& model, uint8_t orientation) {
+    return getRotatedTemplate(getTemplate(model), orientation);
+}
+
+PrefabMesher::ModelTemplate& PrefabMesher::getTemplate(const Model& model) {
+    auto it = templates.find(&model);
+    if (it != templates.end()) {
+        return it->second;
+    }
+
+    ModelTemplate& modelTemplate = templates[&model];
+    bakeTemplate(model, modelTemplate.mesh);
+
+    // Simplified once here, every orientation and block instance reuses the result
+    if (simplifyBudget > 0 && !model.isCube) {
+        uint32_t originalCount = 0;
+        for (const auto& face : modelTemplate.mesh.faces) {
+            originalCount += face.vertexCount - 2u;
+        }
+        uint32_t triangleCount = MeshSimplifier::simplify(modelTemplate.mesh, simplifyBudget);
+        if (triangleCount < originalCount) {
+            simplifyStats.modelCount++;
+            simplifyStats.trianglesBefore += originalCount;
+            simplifyStats.trianglesAfter += triangleCount;
+        }
+    }
 
-        // Generate mesh for all nodes in the model
-        for (int i = 0; i < model->nodeCount; ++i) {
-            const ModelNode& node = model->allNodes[i];
+    // Node transforms move vertices after they were added, so bounds are taken at the end
+    modelTemplate.mesh.computeBounds();
+    return modelTemplate;
+}
 
-            if (!node.visible) continue;
+const Mesh& PrefabMesher::getRotatedTemplate(ModelTemplate& modelTemplate, uint8_t orientation) {
+    if (orientation == BlockRotation::IdentityOrientation) {
+        return modelTemplate.mesh;
+    }
 
-            if (node.type == ModelNode::ShapeType::Box) {
-                generateBoxNode(outputMesh, *model, node, block.x, block.y, block.z, block.rotation);
+    std::unique_ptr<Mesh>& rotated = modelTemplate.rotated[orientation];
+    if (!rotated) {
+        // Bake the block rotation into a copy of the template once per orientation,
+        // turning about the cell centre so pitch and roll keep the block in its cell
+        const BlockRotation::Matrix& matrix = BlockRotation::Orientations[orientation];
+        Mat4 rotation = Mat4::Identity();
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                rotation.m[i][j] = matrix.m[i][j];
             }
-            else if (node.type == ModelNode::ShapeType::Quad) {
-                generateQuadNode(outputMesh, *model, node, block.x, block.y, block.z, block.rotation);
+        }
+        Vec3 pivot(0.0f, BlockRotation::PivotY, 0.0f);
+        rotation = Mat4::Translate(pivot) * rotation * Mat4::Translate(pivot * -1.0f);
+
+        rotated = std::make_unique<Mesh>(modelTemplate.mesh);
+        transformVertices(*rotated, 0, rotation);
+        rotated->computeBounds();
+    }
+    return *rotated;
+}
+
+const PrefabMesher::CubeFaces& PrefabMesher::getCubeFaces(ModelTemplate& modelTemplate, uint8_t orientation) {
+    std::unique_ptr<CubeFaces>& cubeFaces = modelTemplate.cubeFaces[orientation];
+    if (cubeFaces) {
+        return *cubeFaces;
+    }
+
+    cubeFaces = std::make_unique<CubeFaces>();
+    const Mesh& templateMesh = getRotatedTemplate(modelTemplate, orientation);
+    if (templateMesh.faces.size() > 6) {
+        return *cubeFaces;
+    }
+
+    // Every quad has to lie flat on its own side of the cell
+    for (const auto& face : templateMesh.faces) {
+        if (face.vertexCount != 4 || !isFaceOnCellSide(templateMesh, face, 0)) {
+            return *cubeFaces;
+        }
+
+        int side = CubeGeometry::faceFromNormal(templateMesh.vertices[face.indices[0]].normal);
+        if (cubeFaces->presentFaces & (1 << side)) {
+            return *cubeFaces;
+        }
+        cubeFaces->presentFaces |= static_cast<uint8_t>(1 << side);
+        cubeFaces->sides[cubeFaces->sideCount++] = static_cast<uint8_t>(side);
+        cubeFaces->materials[side] = face.material;
+        cubeFaces->quadMin[side] = templateMesh.vertices[face.indices[0]].position;
+        cubeFaces->quadMax[side] = cubeFaces->quadMin[side];
+        for (int i = 0; i < 4; ++i) {
+            const Vertex& vertex = templateMesh.vertices[face.indices[i]];
+            cubeFaces->quads[side][i] = vertex;
+            cubeFaces->quadMin[side] = Vec3::Min(cubeFaces->quadMin[side], vertex.position);
+            cubeFaces->quadMax[side] = Vec3::Max(cubeFaces->quadMax[side], vertex.position);
+        }
+    }
+    cubeFaces->valid = true;
+    return *cubeFaces;
+}
+
+void PrefabMesher::appendCube(Mesh& outputMesh, ModelTemplate& modelTemplate, const CubeFaces& cubeFaces,
+    int32_t worldX, int32_t worldY, int32_t worldZ, uint8_t visibleFaces) {
+    uint8_t faces = cubeFaces.presentFaces & visibleFaces;
+    if (faces == 0) return;
+
+    mapTemplateMaterials(outputMesh, modelTemplate);
+
+    Vec3 worldPosition(static_cast<float>(worldX), static_cast<float>(worldY), static_cast<float>(worldZ));
+    for (uint8_t i = 0; i < cubeFaces.sideCount; ++i) {
+        int side = cubeFaces.sides[i];
+        if (!(faces & (1 << side))) continue;
+
+        uint32_t baseVertex = static_cast<uint32_t>(outputMesh.vertices.size());
+        for (const Vertex& corner : cubeFaces.quads[side]) {
+            Vertex v = corner;
+            v.position += worldPosition;
+            outputMesh.vertices.push_back(v);
+        }
+        outputMesh.mergeBounds(cubeFaces.quadMin[side] + worldPosition, cubeFaces.quadMax[side] + worldPosition);
+
+        MeshFace face;
+        for (uint32_t i = 0; i < 4; ++i) {
+            face.indices[i] = baseVertex + i;
+        }
+        uint16_t material = cubeFaces.materials[side];
+        face.material = material == MeshFace::NoMaterial ? material : modelTemplate.outputMaterials[material];
+        outputMesh.addFace(face);
+    }
+}
+
+void PrefabMesher::bakeTemplate(const Model& model, Mesh& templateMesh) {
+    std::vector<int> faceNodes;
+    std::vector<NodeBounds> occluders;
+
+    // Generate mesh for all nodes in the model, in block-local space
+    for (int i = 0; i < model.nodeCount; ++i) {
+        const ModelNode& node = model.allNodes[i];
+
+        if (!node.visible) continue;
+
+        if (node.type == ModelNode::ShapeType::Box) {
+            generateBoxNode(templateMesh, model, node);
+
+            NodeBounds bounds;
+            if (getOccluderBounds(model, i, bounds)) {
+                occluders.push_back(bounds);
             }
         }
+        else if (node.type == ModelNode::ShapeType::Quad) {
+            generateQuadNode(templateMesh, model, node);
+        }
+        faceNodes.resize(templateMesh.faces.size(), i);
     }
+
+    // Done once per model, so every block using it gets the smaller template
+    if (occluders.size() > 0 && model.nodeCount > 1) {
+        removeHiddenFaces(templateMesh, faceNodes, occluders);
+    }
+    MeshOptimizer::mergeCoplanarQuads(templateMesh);
+}
+
+bool PrefabMesher::getOccluderBounds(const Model& model, int nodeIndex, NodeBounds& bounds) const {
+    const ModelNode& node = model.allNodes[nodeIndex];
+    if (node.textureLayout.size() < 6) return false;
+    for (const auto& faceLayout : node.textureLayout) {
+        if (faceLayout.hidden) return false; // Open boxes can be seen into
+    }
+
+    // Cutout texels (leaves, glass, fences) show what is behind them, so every face
+    // has to sample only fully opaque texels
+    uint32_t textureWidth, textureHeight;
+    if (!textureRegistry->getTextureSize(model.textureId, textureWidth, textureHeight)) return false;
+    for (size_t face = 0; face < 6; ++face) {
+        TexelRect rect;
+        if (!node.getFaceTexelRect(face, textureWidth, textureHeight, rect) ||
+            !textureRegistry->isOpaque(model.textureId, rect)) {
+            return false;
+        }
+    }
+
+    // Only boxes whose rotation maps axes onto axes stay axis-aligned
+    Mat4 transform = calculateNodeTransform(model, node);
+    for (int row = 0; row < 3; ++row) {
+        int nonZero = 0;
+        for (int col = 0; col < 3; ++col) {
+            if (std::abs(transform.m[row][col]) > 1e-5f) nonZero++;
+        }
+        if (nonZero != 1) return false;
+    }
+
+    Vec3 center = node.offset * (1.0f / 32.0f);
+    Vec3 halfSize = node.size * (1.0f / 32.0f) * 0.5f;
+    for (int corner = 0; corner < 8; ++corner) {
+        Vec3 local = center + Vec3(corner & 1 ? halfSize.x : -halfSize.x,
+            corner & 2 ? halfSize.y : -halfSize.y, corner & 4 ? halfSize.z : -halfSize.z);
+        Vec3 p = transform.transformPoint(local);
+        if (corner == 0) {
+            bounds.min = bounds.max = p;
+            continue;
+        }
+        bounds.min = Vec3::Min(bounds.min, p);
+        bounds.max = Vec3::Max(bounds.max, p);
+    }
+    bounds.node = nodeIndex;
+    return true;
+}
+
+void PrefabMesher::removeHiddenFaces(Mesh& templateMesh, const std::vector<int>& faceNodes,
+    const std::vector<NodeBounds>& occluders) const {
+    constexpr float Epsilon = 1e-4f;
+    auto axisValue = [](const Vec3& v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); };
+
+    std::vector<MeshFace> visible;
+    visible.reserve(templateMesh.faces.size());
+    for (size_t f = 0; f < templateMesh.faces.size(); ++f) {
+        const MeshFace& face = templateMesh.faces[f];
+
+        // Axis-aligned faces only, given by their side, plane and extent in the plane
+        const Vec3& normal = templateMesh.vertices[face.indices[0]].normal;
+        int side = CubeGeometry::faceFromNormal(normal);
+        const int* direction = CubeGeometry::Faces[side].normal;
+        int axis = direction[0] != 0 ? 0 : (direction[1] != 0 ? 1 : 2);
+        int sign = direction[axis];
+        bool hidden = std::abs(axisValue(normal, axis)) > 0.999f;
+
+        Vec3 faceMin = templateMesh.vertices[face.indices[0]].position;
+        Vec3 faceMax = faceMin;
+        for (uint8_t i = 1; i < face.vertexCount && hidden; ++i) {
+            const Vec3& p = templateMesh.vertices[face.indices[i]].position;
+            faceMin = Vec3::Min(faceMin, p);
+            faceMax = Vec3::Max(faceMax, p);
+        }
+        hidden = hidden && axisValue(faceMax, axis) - axisValue(faceMin, axis) <= Epsilon;
+
+        // A face is hidden when a sibling box covers its whole extent and reaches past
+        // the plane on the side the face looks towards, whether the face lies inside
+        // that box or against one of its sides
+        if (hidden) {
+            hidden = false;
+            float plane = axisValue(faceMin, axis);
+            for (const auto& occluder : occluders) {
+                if (occluder.node == faceNodes[f]) continue;
+
+                bool covers = true;
+                for (int other = 0; other < 3 && covers; ++other) {
+                    if (other == axis) continue;
+                    covers = axisValue(occluder.min, other) <= axisValue(faceMin, other) + Epsilon &&
+                        axisValue(occluder.max, other) >= axisValue(faceMax, other) - Epsilon;
+                }
+                if (!covers) continue;
+
+                bool inFront = sign > 0 ?
+                    axisValue(occluder.min, axis) <= plane + Epsilon && axisValue(occluder.max, axis) > plane + Epsilon :
+                    axisValue(occluder.max, axis) >= plane - Epsilon && axisValue(occluder.min, axis) < plane - Epsilon;
+                if (inFront) {
+                    hidden = true;
+                    break;
+                }
+            }
+        }
+
+        if (!hidden) visible.push_back(face);
+    }
+
+    if (visible.size() != templateMesh.faces.size()) {
+        templateMesh.faces.swap(visible);
+        MeshOptimizer::optimizeVertexFetch(templateMesh);
+    }
+}
+
+void PrefabMesher::mapTemplateMaterials(Mesh& outputMesh, ModelTemplate& modelTemplate) {
+    // Template materials are mapped into the output table once per output mesh, and the
+    // faces with them. Faces are shared by every orientation, only vertices are rotated.
+    if (!modelTemplate.outputFaces.empty()) return;
+
+    modelTemplate.outputMaterials.reserve(modelTemplate.mesh.materials.size());
+    for (const auto& material : modelTemplate.mesh.materials) {
+        modelTemplate.outputMaterials.push_back(outputMesh.getOrAddMaterial(material));
+    }
+    modelTemplate.outputFaces = modelTemplate.mesh.faces;
+    for (auto& face : modelTemplate.outputFaces) {
+        if (face.material != MeshFace::NoMaterial) {
+            face.material = modelTemplate.outputMaterials[face.material];
+        }
+    }
+}
+
+void PrefabMesher::appendTemplate(Mesh& outputMesh, ModelTemplate& modelTemplate,
+    int32_t worldX, int32_t worldY, int32_t worldZ, uint8_t orientation, uint8_t visibleFaces) {
+    const Mesh& templateMesh = getRotatedTemplate(modelTemplate, orientation);
+    if (templateMesh.faces.empty()) return;
+
+    mapTemplateMaterials(outputMesh, modelTemplate);
+
+    uint32_t baseVertex = static_cast<uint32_t>(outputMesh.vertices.size());
+    Vec3 worldPosition(worldX, worldY, worldZ);
+
+    if (visibleFaces != ExteriorShell::AllFaces) {
+        // Faces flush with a hidden side of the cell are dropped, along with any
+        // vertices only they used
+        vertexRemap.assign(templateMesh.vertices.size(), UINT32_MAX);
+        for (const auto& face : templateMesh.faces) {
+            if (isFaceOnCellSide(templateMesh, face, visibleFaces)) continue;
+
+            MeshFace f = face;
+            for (uint8_t i = 0; i < f.vertexCount; ++i) {
+                uint32_t& remapped = vertexRemap[f.indices[i]];
+                if (remapped == UINT32_MAX) {
+                    Vertex v = templateMesh.vertices[f.indices[i]];
+                    v.position += worldPosition;
+                    remapped = outputMesh.addVertex(v);
+                }
+                f.indices[i] = remapped;
+            }
+            if (f.material != MeshFace::NoMaterial) {
+                f.material = modelTemplate.outputMaterials[f.material];
+            }
+            outputMesh.addFace(f);
+        }
+        return;
+    }
+
+    // Straight copy and offset, every per-face decision was made when the template was baked
+    outputMesh.vertices.insert(outputMesh.vertices.end(), templateMesh.vertices.begin(), templateMesh.vertices.end());
+    Vertex* vertices = outputMesh.vertices.data() + baseVertex;
+    for (size_t i = 0; i < templateMesh.vertices.size(); ++i) {
+        vertices[i].position += worldPosition;
+    }
+    outputMesh.mergeBounds(templateMesh.minBounds + worldPosition, templateMesh.maxBounds + worldPosition);
+
+    // Unused fourth indices of triangles are offset too, nothing reads past vertexCount
+    size_t firstFace = outputMesh.faces.size();
+    outputMesh.faces.insert(outputMesh.faces.end(), modelTemplate.outputFaces.begin(), modelTemplate.outputFaces.end());
+    MeshFace* faces = outputMesh.faces.data() + firstFace;
+    for (size_t i = 0; i < modelTemplate.outputFaces.size(); ++i) {
+        for (int j = 0; j < 4; ++j) {
+            faces[i].indices[j] += baseVertex;
+        }
+    }
+}
+
+bool PrefabMesher::isFaceOnCellSide(const Mesh& templateMesh, const MeshFace& face,
+    uint8_t visibleFaces) const {
+    if (face.vertexCount < 3) return false;
+
+    // Facing from the winding rather than the vertex normals, so the back of a
+    // double-sided quad is told apart from its front
+    const Vec3& p0 = templateMesh.vertices[face.indices[0]].position;
+    const Vec3& p1 = templateMesh.vertices[face.indices[1]].position;
+    const Vec3& p2 = templateMesh.vertices[face.indices[2]].position;
+    Vec3 edge1 = p1 - p0;
+    Vec3 edge2 = p2 - p0;
+    Vec3 normal(edge2.y * edge1.z - edge2.z * edge1.y,
+        edge2.z * edge1.x - edge2.x * edge1.z,
+        edge2.x * edge1.y - edge2.y * edge1.x);
+
+    int side = CubeGeometry::faceFromNormal(normal);
+    if (visibleFaces & (1 << side)) return false;
+
+    // Only faces lying in the plane of that side are covered by the neighbour
+    const CubeGeometry::Face& cubeFace = CubeGeometry::Faces[side];
+    const int axis = cubeFace.normal[0] != 0 ? 0 : (cubeFace.normal[1] != 0 ? 1 : 2);
+    const float plane = axis == 0 ? cubeFace.corners[0].x : (axis == 1 ? cubeFace.corners[0].y : cubeFace.corners[0].z);
+    constexpr float Epsilon = 1e-4f;
+
+    for (uint8_t i = 0; i < face.vertexCount; ++i) {
+        const Vec3& p = templateMesh.vertices[face.indices[i]].position;
+        float coordinate = axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+        if (std::abs(coordinate - plane) > Epsilon) return false;
+    }
+    return true;
 }
 
 void PrefabMesher::generateBoxNode(Mesh& outputMesh, const Model& model,
-    const ModelNode& node, int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation) {
+    const ModelNode& node) {
     Mat4 transform = calculateNodeTransform(model, node);
     Vec3 halfSize = node.size * (1.0f / 32.0f) * 0.5f;
+    size_t firstVertex = outputMesh.vertices.size();
 
     for (int faceIdx = 0; faceIdx < 6; ++faceIdx) {
         if (faceIdx >= node.textureLayout.size()) continue;
@@ -44,27 +497,29 @@ void PrefabMesher::generateBoxNode(Mesh& outputMesh, const Model& model,
         const ModelFaceTextureLayout& faceLayout = node.textureLayout[faceIdx];
         if (faceLayout.hidden) continue;
 
-        generateBoxFace(outputMesh, model, node, static_cast<ModelNode::QuadNormal>(faceIdx),
-            transform, halfSize, worldX, worldY, worldZ, rotation);
+        generateBoxFace(outputMesh, model, node, static_cast<ModelNode::QuadNormal>(faceIdx), halfSize);
     }
+
+    // Apply node transform to all faces of the box at once
+    transformVertices(outputMesh, firstVertex, transform);
 }
 
 void PrefabMesher::generateQuadNode(Mesh& outputMesh, const Model& model,
-    const ModelNode& node, int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation) {
+    const ModelNode& node) {
     Mat4 transform = calculateNodeTransform(model, node);
     Vec2 halfSize(node.size.x * (1.0f / 32.0f) * 0.5f, node.size.y * (1.0f / 32.0f) * 0.5f);
     if (!node.textureLayout.empty()) {
         const ModelFaceTextureLayout& faceLayout = node.textureLayout[0];
         if (!faceLayout.hidden) {
-            generateQuadFace(outputMesh, model, node, node.quadNormalDirection,
-                transform, halfSize, worldX, worldY, worldZ, rotation);
+            size_t firstVertex = outputMesh.vertices.size();
+            generateQuadFace(outputMesh, model, node, node.quadNormalDirection, halfSize);
+            transformVertices(outputMesh, firstVertex, transform);
         }
     }
 }
 
 void PrefabMesher::generateBoxFace(Mesh& outputMesh, const Model& model,
-    const ModelNode& node, ModelNode::QuadNormal face, const Mat4& transform,
-    const Vec3& halfSize, int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation) {
+    const ModelNode& node, ModelNode::QuadNormal face, const Vec3& halfSize) {
 
     int faceIndex = static_cast<int>(face);
     if (faceIndex >= node.textureLayout.size()) return;
@@ -72,117 +527,25 @@ void PrefabMesher::generateBoxFace(Mesh& outputMesh, const Model& model,
     const ModelFaceTextureLayout& faceLayout = node.textureLayout[faceIndex];
     if (faceLayout.hidden) return;
 
+    // Corners come from the unit cube table, scaled to the box and recentred on y
     Vec3 center = node.offset * (1.0f / 32.0f);
-    Vertex v0, v1, v2, v3;
-
-    // Define quad vertices based on face direction
-    switch (face) {
-    case ModelNode::QuadNormal::MinusZ:
-        v0.position = center + Vec3(-halfSize.x, -halfSize.y, -halfSize.z);
-        v1.position = center + Vec3(halfSize.x, -halfSize.y, -halfSize.z);
-        v2.position = center + Vec3(halfSize.x, halfSize.y, -halfSize.z);
-        v3.position = center + Vec3(-halfSize.x, halfSize.y, -halfSize.z);
-        v0.normal = v1.normal = v2.normal = v3.normal = Vec3(0, 0, -1);
-        break;
-
-    case ModelNode::QuadNormal::PlusZ:
-        v0.position = center + Vec3(halfSize.x, -halfSize.y, halfSize.z);
-        v1.position = center + Vec3(-halfSize.x, -halfSize.y, halfSize.z);
-        v2.position = center + Vec3(-halfSize.x, halfSize.y, halfSize.z);
-        v3.position = center + Vec3(halfSize.x, halfSize.y, halfSize.z);
-        v0.normal = v1.normal = v2.normal = v3.normal = Vec3(0, 0, 1);
-        break;
-
-    case ModelNode::QuadNormal::PlusX:
-        v0.position = center + Vec3(halfSize.x, -halfSize.y, -halfSize.z);
-        v1.position = center + Vec3(halfSize.x, -halfSize.y, halfSize.z);
-        v2.position = center + Vec3(halfSize.x, halfSize.y, halfSize.z);
-        v3.position = center + Vec3(halfSize.x, halfSize.y, -halfSize.z);
-        v0.normal = v1.normal = v2.normal = v3.normal = Vec3(1, 0, 0);
-        break;
-
-    case ModelNode::QuadNormal::MinusX:
-        v0.position = center + Vec3(-halfSize.x, -halfSize.y, halfSize.z);
-        v1.position = center + Vec3(-halfSize.x, -halfSize.y, -halfSize.z);
-        v2.position = center + Vec3(-halfSize.x, halfSize.y, -halfSize.z);
-        v3.position = center + Vec3(-halfSize.x, halfSize.y, halfSize.z);
-        v0.normal = v1.normal = v2.normal = v3.normal = Vec3(-1, 0, 0);
-        break;
-
-    case ModelNode::QuadNormal::PlusY:
-        v0.position = center + Vec3(-halfSize.x, halfSize.y, -halfSize.z);
-        v1.position = center + Vec3(halfSize.x, halfSize.y, -halfSize.z);
-        v2.position = center + Vec3(halfSize.x, halfSize.y, halfSize.z);
-        v3.position = center + Vec3(-halfSize.x, halfSize.y, halfSize.z);
-        v0.normal = v1.normal = v2.normal = v3.normal = Vec3(0, 1, 0);
-        break;
-
-    case ModelNode::QuadNormal::MinusY:
-        v0.position = center + Vec3(-halfSize.x, -halfSize.y, halfSize.z);
-        v1.position = center + Vec3(halfSize.x, -halfSize.y, halfSize.z);
-        v2.position = center + Vec3(halfSize.x, -halfSize.y, -halfSize.z);
-        v3.position = center + Vec3(-halfSize.x, -halfSize.y, -halfSize.z);
-        v0.normal = v1.normal = v2.normal = v3.normal = Vec3(0, -1, 0);
-        break;
-    }
-
-    // Apply node transform
-    v0.position = transformPoint(transform, v0.position);
-    v1.position = transformPoint(transform, v1.position);
-    v2.position = transformPoint(transform, v2.position);
-    v3.position = transformPoint(transform, v3.position);
-
-    Mat4 normalTransform = extractRotation(transform);
-    v0.normal = transformNormal(normalTransform, v0.normal);
-    v1.normal = transformNormal(normalTransform, v1.normal);
-    v2.normal = transformNormal(normalTransform, v2.normal);
-    v3.normal = transformNormal(normalTransform, v3.normal);
-
-    // Apply UVs
-    Vec2 uvMin, uvMax;
-    if (getAtlasUVs(faceLayout, faceLayout.offset, node.size, uvMin, uvMax)) {
-
-        v0.uv = Vec2(uvMin.u, uvMax.v);
-        v1.uv = Vec2(uvMax.u, uvMax.v);
-        v2.uv = Vec2(uvMax.u, uvMin.v);
-        v3.uv = Vec2(uvMin.u, uvMin.v);
-
-        if (faceLayout.angle != 0) {
-            rotateUVs(v0.uv, v1.uv, v2.uv, v3.uv, faceLayout.angle);
-        }
-
-        if (faceLayout.mirrorX) {
-            std::swap(v0.uv.u, v1.uv.u);
-            std::swap(v2.uv.u, v3.uv.u);
-        }
-        if (faceLayout.mirrorY) {
-            std::swap(v0.uv.v, v3.uv.v);
-            std::swap(v1.uv.v, v2.uv.v);
-        }
+    const CubeGeometry::Face& cubeFace = CubeGeometry::Faces[faceIndex];
+    Vec3 normal(static_cast<float>(cubeFace.normal[0]), static_cast<float>(cubeFace.normal[1]),
+        static_cast<float>(cubeFace.normal[2]));
+    Vertex quad[4];
+    for (int i = 0; i < 4; ++i) {
+        const CubeGeometry::Corner& corner = cubeFace.corners[i];
+        quad[i].position = center + Vec3(corner.x * 2.0f * halfSize.x, (corner.y * 2.0f - 1.0f) * halfSize.y,
+            corner.z * 2.0f * halfSize.z);
+        quad[i].normal = normal;
     }
-
-    // Apply block rotation
-    v0.position = rotateVertex(v0.position, rotation);
-    v1.position = rotateVertex(v1.position, rotation);
-    v2.position = rotateVertex(v2.position, rotation);
-    v3.position = rotateVertex(v3.position, rotation);
-
-    v0.normal = rotateNormal(v0.normal, rotation);
-    v1.normal = rotateNormal(v1.normal, rotation);
-    v2.normal = rotateNormal(v2.normal, rotation);
-    v3.normal = rotateNormal(v3.normal, rotation);
-
-    // Apply world position
-    v0.position += Vec3(worldX, worldY, worldZ);
-    v1.position += Vec3(worldX, worldY, worldZ);
-    v2.position += Vec3(worldX, worldY, worldZ);
-    v3.position += Vec3(worldX, worldY, worldZ);
+    uint32_t atlasPage = applyFaceUVs(quad, model, node, faceIndex);
 
     // Add to mesh
-    uint32_t idx0 = outputMesh.addVertex(v0);
-    uint32_t idx1 = outputMesh.addVertex(v1);
-    uint32_t idx2 = outputMesh.addVertex(v2);
-    uint32_t idx3 = outputMesh.addVertex(v3);
+    uint32_t idx0 = outputMesh.addVertex(quad[0]);
+    uint32_t idx1 = outputMesh.addVertex(quad[1]);
+    uint32_t idx2 = outputMesh.addVertex(quad[2]);
+    uint32_t idx3 = outputMesh.addVertex(quad[3]);
 
     MeshFace quadFace;
     quadFace.indices[0] = idx0;
@@ -190,98 +553,35 @@ void PrefabMesher::generateBoxFace(Mesh& outputMesh, const Model& model,
     quadFace.indices[2] = idx2;
     quadFace.indices[3] = idx3;
     quadFace.vertexCount = 4;
-    // TODO: Replace this with not just a random material assignment
-    quadFace.material = std::to_string(node.nameId);
+    // Faces share a material per node name and atlas page
+    quadFace.material = getNodeMaterial(outputMesh, node, atlasPage);
     outputMesh.addFace(quadFace);
 }
 
 void PrefabMesher::generateQuadFace(Mesh& outputMesh, const Model& model,
-    const ModelNode& node, ModelNode::QuadNormal normalDir, const Mat4& transform,
-    const Vec2& halfSize, int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation) {
+    const ModelNode& node, ModelNode::QuadNormal normalDir, const Vec2& halfSize) {
 
     if (node.textureLayout.empty()) return;
 
     const ModelFaceTextureLayout& faceLayout = node.textureLayout[0];
     if (faceLayout.hidden) return;
 
-    Vertex v0, v1, v2, v3;
-
     // Quad is in XY plane by default, facing +Z
-    v0.position = Vec3(-halfSize.u, -halfSize.v, 0);
-    v1.position = Vec3(halfSize.u, -halfSize.v, 0);
-    v2.position = Vec3(halfSize.u, halfSize.v, 0);
-    v3.position = Vec3(-halfSize.u, halfSize.v, 0);
-
-    // Normal depends on quad direction
-    Vec3 normal;
-    switch (normalDir) {
-    case ModelNode::QuadNormal::PlusZ:  normal = Vec3(0, 0, 1); break;
-    case ModelNode::QuadNormal::MinusZ: normal = Vec3(0, 0, -1); break;
-    case ModelNode::QuadNormal::PlusX:  normal = Vec3(1, 0, 0); break;
-    case ModelNode::QuadNormal::MinusX: normal = Vec3(-1, 0, 0); break;
-    case ModelNode::QuadNormal::PlusY:  normal = Vec3(0, 1, 0); break;
-    case ModelNode::QuadNormal::MinusY: normal = Vec3(0, -1, 0); break;
-    }
-
-    v0.normal = v1.normal = v2.normal = v3.normal = normal;
-
-    // Apply node transform
-    v0.position = transformPoint(transform, v0.position);
-    v1.position = transformPoint(transform, v1.position);
-    v2.position = transformPoint(transform, v2.position);
-    v3.position = transformPoint(transform, v3.position);
-
-    Mat4 normalTransform = extractRotation(transform);
-    v0.normal = transformNormal(normalTransform, v0.normal);
-    v1.normal = transformNormal(normalTransform, v1.normal);
-    v2.normal = transformNormal(normalTransform, v2.normal);
-    v3.normal = transformNormal(normalTransform, v3.normal);
-
-    // Apply UVs
-    Vec2 uvMin, uvMax;
-    Vec3 quadSize(node.size.x, node.size.y, 0);
-    if (getAtlasUVs(faceLayout, faceLayout.offset, quadSize, uvMin, uvMax)) {
-        v0.uv = Vec2(uvMin.u, uvMax.v);
-        v1.uv = Vec2(uvMax.u, uvMax.v);
-        v2.uv = Vec2(uvMax.u, uvMin.v);
-        v3.uv = Vec2(uvMin.u, uvMin.v);
-
-        if (faceLayout.angle != 0) {
-            rotateUVs(v0.uv, v1.uv, v2.uv, v3.uv, faceLayout.angle);
-        }
-
-        if (faceLayout.mirrorX) {
-            std::swap(v0.uv.u, v1.uv.u);
-            std::swap(v2.uv.u, v3.uv.u);
-        }
-        if (faceLayout.mirrorY) {
-            std::swap(v0.uv.v, v3.uv.v);
-            std::swap(v1.uv.v, v2.uv.v);
-        }
-    }
-
-    // Apply block rotation
-    v0.position = rotateVertex(v0.position, rotation);
-    v1.position = rotateVertex(v1.position, rotation);
-    v2.position = rotateVertex(v2.position, rotation);
-    v3.position = rotateVertex(v3.position, rotation);
-
-    v0.normal = rotateNormal(v0.normal, rotation);
-    v1.normal = rotateNormal(v1.normal, rotation);
-    v2.normal = rotateNormal(v2.normal, rotation);
-    v3.normal = rotateNormal(v3.normal, rotation);
-
-    // Apply world position
-    v0.position += Vec3(worldX, worldY, worldZ);
-    v1.position += Vec3(worldX, worldY, worldZ);
-    v2.position += Vec3(worldX, worldY, worldZ);
-    v3.position += Vec3(worldX, worldY, worldZ);
+    const int* direction = CubeGeometry::Faces[static_cast<int>(normalDir)].normal;
+    Vec3 normal(static_cast<float>(direction[0]), static_cast<float>(direction[1]), static_cast<float>(direction[2]));
+    Vertex quad[4];
+    quad[0].position = Vec3(-halfSize.u, -halfSize.v, 0);
+    quad[1].position = Vec3(halfSize.u, -halfSize.v, 0);
+    quad[2].position = Vec3(halfSize.u, halfSize.v, 0);
+    quad[3].position = Vec3(-halfSize.u, halfSize.v, 0);
+    quad[0].normal = quad[1].normal = quad[2].normal = quad[3].normal = normal;
+    uint32_t atlasPage = applyFaceUVs(quad, model, node, 0);
 
     // Add to mesh
-    uint32_t idx0 = outputMesh.addVertex(v0);
-    uint32_t idx1 = outputMesh.addVertex(v1);
-    uint32_t idx2 = outputMesh.addVertex(v2);
-    uint32_t idx3 = outputMesh.addVertex(v3);
+    uint32_t idx0 = outputMesh.addVertex(quad[0]);
+    uint32_t idx1 = outputMesh.addVertex(quad[1]);
+    uint32_t idx2 = outputMesh.addVertex(quad[2]);
+    uint32_t idx3 = outputMesh.addVertex(quad[3]);
 
     MeshFace quadFace;
     quadFace.indices[0] = idx0;
@@ -289,22 +589,35 @@ void PrefabMesher::generateQuadFace(Mesh& outputMesh, const Model& model,
     quadFace.indices[2] = idx2;
     quadFace.indices[3] = idx3;
     quadFace.vertexCount = 4;
-    quadFace.material = std::to_string(node.nameId);
+    quadFace.material = getNodeMaterial(outputMesh, node, atlasPage);
 
     outputMesh.addFace(quadFace);
 
     if (node.doubleSided) {
+        // The back gets its own vertices so its normals face the other way
+        for (int i = 0; i < 4; ++i) {
+            quad[i].normal = normal * -1.0f;
+        }
         MeshFace backFace;
-        backFace.indices[0] = idx3;
-        backFace.indices[1] = idx2;
-        backFace.indices[2] = idx1;
-        backFace.indices[3] = idx0;
+        backFace.indices[0] = outputMesh.addVertex(quad[3]);
+        backFace.indices[1] = outputMesh.addVertex(quad[2]);
+        backFace.indices[2] = outputMesh.addVertex(quad[1]);
+        backFace.indices[3] = outputMesh.addVertex(quad[0]);
         backFace.vertexCount = 4;
         backFace.material = quadFace.material;
         outputMesh.addFace(backFace);
     }
 }
 
+uint16_t PrefabMesher::getNodeMaterial(Mesh& templateMesh, const ModelNode& node, uint32_t atlasPage) const {
+    // Node names are shared between models, so faces on other atlas pages get their own copy
+    MeshMaterial material{ .name = std::to_string(node.nameId), .atlasPage = atlasPage };
+    if (atlasPage > 0) {
+        material.name += "_p" + std::to_string(atlasPage);
+    }
+    return templateMesh.getOrAddMaterial(material);
+}
+
 Mat4 PrefabMesher::calculateNodeTransform(const Model& model, const ModelNode& node) const {
     int nodeIndex = -1;
     for (int i = 0; i < model.nodeCount; ++i) {
@@ -339,65 +652,73 @@ Mat4 PrefabMesher::calculateNodeTransform(const Model& model, const ModelNode& n
     return transform;
 }
 
-Vec3 PrefabMesher::transformPoint(const Mat4& matrix, const Vec3& point) const {
-    float x = matrix.m[0][0] * point.x + matrix.m[0][1] * point.y + matrix.m[0][2] * point.z + matrix.m[0][3];
-    float y = matrix.m[1][0] * point.x + matrix.m[1][1] * point.y + matrix.m[1][2] * point.z + matrix.m[1][3];
-    float z = matrix.m[2][0] * point.x + matrix.m[2][1] * point.y + matrix.m[2][2] * point.z + matrix.m[2][3];
-    return Vec3(x, y, z);
-}
+void PrefabMesher::transformVertices(Mesh& mesh, size_t firstVertex, const Mat4& transform) {
+    size_t count = mesh.vertices.size() - firstVertex;
+    if (count == 0) return;
+
+    // Gather into SoA streams for the batch kernel, then scatter back
+    transformStreams.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& v = mesh.vertices[firstVertex + i];
+        transformStreams.px[i] = v.position.x;
+        transformStreams.py[i] = v.position.y;
+        transformStreams.pz[i] = v.position.z;
+        transformStreams.nx[i] = v.normal.x;
+        transformStreams.ny[i] = v.normal.y;
+        transformStreams.nz[i] = v.normal.z;
+    }
 
-Vec3 PrefabMesher::transformNormal(const Mat4& matrix, const Vec3& normal) const {
-    float x = matrix.m[0][0] * normal.x + matrix.m[0][1] * normal.y + matrix.m[0][2] * normal.z;
-    float y = matrix.m[1][0] * normal.x + matrix.m[1][1] * normal.y + matrix.m[1][2] * normal.z;
-    float z = matrix.m[2][0] * normal.x + matrix.m[2][1] * normal.y + matrix.m[2][2] * normal.z;
-    return Vec3(x, y, z).normalize();
-}
+    TransformKernel::transform(transform, transformStreams);
 
-Mat4 PrefabMesher::extractRotation(const Mat4& matrix) const {
-    Mat4 result = Mat4::Identity();
-    for (int i = 0; i < 3; ++i) {
-        for (int j = 0; j < 3; ++j) {
-            result.m[i][j] = matrix.m[i][j];
-        }
+    for (size_t i = 0; i < count; ++i) {
+        Vertex& v = mesh.vertices[firstVertex + i];
+        v.position = Vec3(transformStreams.px[i], transformStreams.py[i], transformStreams.pz[i]);
+        v.normal = Vec3(transformStreams.nx[i], transformStreams.ny[i], transformStreams.nz[i]);
     }
-    return result;
 }
 
-bool PrefabMesher::getAtlasUVs(const ModelFaceTextureLayout& faceLayout, const Vec2& pixelOffset,
-    const Vec3& nodeSize, Vec2& uvMin, Vec2& uvMax) const {
+bool PrefabMesher::getAtlasUVs(const Model& model, const ModelNode& node, size_t faceIndex,
+    Vec2& uvMin, Vec2& uvMax, uint32_t& atlasPage) const {
+
+    uint32_t textureWidth, textureHeight;
+    if (!textureRegistry->getTextureSize(model.textureId, textureWidth, textureHeight)) return false;
 
-    uvMin = faceLayout.uvMin;
-    uvMax = faceLayout.uvMax;
+    // Faces without a footprint take the whole texture
+    TexelRect rect = { 0, 0, textureWidth, textureHeight };
+    node.getFaceTexelRect(faceIndex, textureWidth, textureHeight, rect);
+    const AtlasRegion* region = textureRegistry->getTextureRegion(model.textureId, rect);
+    if (!region) return false;
 
+    const ModelFaceTextureLayout& faceLayout = node.textureLayout[faceIndex];
+    Vec2 faceDimensions = node.getFaceDimensions(faceIndex);
+    float regionWidth = static_cast<float>(region->pixelWidth);
+    float regionHeight = static_cast<float>(region->pixelHeight);
+    float atlasWidthInUV = region->uvMax.u - region->uvMin.u;
+    float atlasHeightInUV = region->uvMax.v - region->uvMin.v;
+
+    // Normalize the pixel footprint within the packed part of the texture, then place it in the atlas
+    float offsetU = faceLayout.offset.u - static_cast<float>(region->sourceX);
+    float offsetV = faceLayout.offset.v - static_cast<float>(region->sourceY);
+    uvMin.u = region->uvMin.u + (offsetU / regionWidth) * atlasWidthInUV;
+    uvMin.v = region->uvMin.v + (offsetV / regionHeight) * atlasHeightInUV;
+    uvMax.u = region->uvMin.u + ((offsetU + faceDimensions.u) / regionWidth) * atlasWidthInUV;
+    uvMax.v = region->uvMin.v + ((offsetV + faceDimensions.v) / regionHeight) * atlasHeightInUV;
+    atlasPage = region->page;
     return true;
 }
 
-void PrefabMesher::rotateUVs(Vec2& uv0, Vec2& uv1, Vec2& uv2, Vec2& uv3, int rotation) const {
-    int steps = (rotation / 90) % 4;
-
-    for (int i = 0; i < steps; ++i) {
-        Vec2 temp = uv0;
-        uv0 = uv3;
-        uv3 = uv2;
-        uv2 = uv1;
-        uv1 = temp;
-    }
-}
+uint32_t PrefabMesher::applyFaceUVs(Vertex* quad, const Model& model, const ModelNode& node,
+    size_t faceIndex) const {
+    Vec2 uvMin(0, 0), uvMax(0, 0);
+    uint32_t atlasPage = 0;
+    getAtlasUVs(model, node, faceIndex, uvMin, uvMax, atlasPage);
+    const ModelFaceTextureLayout& faceLayout = node.textureLayout[faceIndex];
 
-Vec3 PrefabMesher::rotateVertex(const Vec3& vertex, uint16_t rotation) const {
-    // Rotation for now is around Y-axis in 90-degree increments (change to handle more complicated rotations)
-    int steps = rotation % 4;
-    Vec3 result = vertex;
-    for (int i = 0; i < steps; ++i) {
-        float newX = result.z;
-        float newZ = -result.x;
-        result.x = newX;
-        result.z = newZ;
+    // Negative angles were never rotated, keep it that way
+    int steps = (faceLayout.angle / 90) % 4;
+    const UVCorners& corners = FaceUVCorners[steps < 0 ? 0 : steps][faceLayout.mirrorX][faceLayout.mirrorY];
+    for (int i = 0; i < 4; ++i) {
+        quad[i].uv = Vec2(corners.useMaxU[i] ? uvMax.u : uvMin.u, corners.useMaxV[i] ? uvMax.v : uvMin.v);
     }
-
-    return result;
+    return atlasPage;
 }
-
-Vec3 PrefabMesher::rotateNormal(const Vec3& normal, uint16_t rotation) const {
-    return rotateVertex(normal, rotation);
-}
\ No newline at end of file
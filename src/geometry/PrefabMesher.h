@@ -3,6 +3,12 @@
 #include "../data/MeshData.h"
 #include "../data/Model.h"
 #include "../data/Vec.h"
+#include "BlockRotation.h"
+#include "ChunkPartitioner.h"
+#include "ExteriorShell.h"
+#include "TransformKernel.h"
+#include <array>
+#include <memory>
 #include <unordered_map>
 #include <string>
 
@@ -12,34 +18,119 @@ public:
 
     void generatePrefabMesh(const Prefab& prefab, Mesh& outputMesh);
 
+    // Incremental meshing: beginMesh clears the mesh, then each chunk appends to it
+    void beginMesh(Mesh& outputMesh);
+    void generateChunkMesh(const Prefab& prefab, const PrefabChunk& chunk, Mesh& outputMesh);
+    // A single block, for callers that need to stop partway through a chunk
+    void generateBlockMesh(const PrefabBlock& block, Mesh& outputMesh);
+
+    // Limits output to the faces visible from outside the prefab, null meshes everything
+    void setExteriorShell(const ExteriorShell* shell);
+
+    // Custom models over this many triangles are simplified once when their template
+    // is baked, 0 keeps every template as modelled
+    void setSimplification(uint32_t triangleBudget);
+
+    // Totals over the templates simplified so far
+    struct SimplifyStats {
+        uint32_t modelCount = 0;
+        uint64_t trianglesBefore = 0;
+        uint64_t trianglesAfter = 0;
+    };
+    const SimplifyStats& getSimplifyStats() const { return simplifyStats; }
+
+    // Model baked once in block-local space (origin at the block position) for one of the
+    // 24 orientations in BlockRotation
+    const Mesh& getModelTemplate(const Model& model,
+        uint8_t orientation = BlockRotation::IdentityOrientation);
+
+    // Per face corner, whether it takes uvMax rather than uvMin on each axis
+    struct UVCorners {
+        bool useMaxU[4];
+        bool useMaxV[4];
+    };
+
 private:
+    // Indexed by quarter turns, mirrorX and mirrorY of a face's texture
+    static const std::array<std::array<std::array<UVCorners, 2>, 2>, 4> FaceUVCorners;
+
+    // Template-space bounds of a closed, axis-aligned box node
+    struct NodeBounds {
+        int node;
+        Vec3 min, max;
+    };
+
+    // Faces of a cube template by CubeGeometry side, so a block only copies the quads of
+    // the sides it shows. Taken from the baked template to keep each orientation's UVs.
+    struct CubeFaces {
+        bool valid = false; // False when the template is not one quad per cell side
+        uint8_t presentFaces = 0; // Bit per side with a quad
+        uint8_t sideCount = 0;
+        std::array<uint8_t, 6> sides; // In the template's face order, so output matches the generic path
+        std::array<std::array<Vertex, 4>, 6> quads;
+        std::array<uint16_t, 6> materials; // Template material ids
+        std::array<Vec3, 6> quadMin;
+        std::array<Vec3, 6> quadMax;
+    };
+
+    struct ModelTemplate {
+        Mesh mesh;
+        std::array<std::unique_ptr<Mesh>, BlockRotation::OrientationCount> rotated;
+        std::array<std::unique_ptr<CubeFaces>, BlockRotation::OrientationCount> cubeFaces;
+        std::vector<uint16_t> outputMaterials; // Template material id -> output mesh material id
+        std::vector<MeshFace> outputFaces; // Template faces with output mesh material ids
+    };
+
     ModelRegistry* modelRegistry;
     TextureRegistry* textureRegistry;
+    std::unordered_map<const Model*, ModelTemplate> templates;
+    VertexStreams transformStreams;
+    const ExteriorShell* exteriorShell = nullptr;
+    uint32_t simplifyBudget = 0;
+    SimplifyStats simplifyStats;
+    std::vector<uint32_t> vertexRemap;
 
-    void generateBoxNode(Mesh& outputMesh, const Model& model,
-        const ModelNode& node, int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation);
-    void generateQuadNode(Mesh& outputMesh, const Model& model,
-        const ModelNode& node, int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation);
+    // Consecutive blocks are usually of one type, so the last lookup is reused
+    std::string cachedBlockName;
+    Model* cachedModel = nullptr;
+    ModelTemplate* cachedTemplate = nullptr; // Template nodes never move, so the pointer stays valid
+
+    void appendBlock(Mesh& outputMesh, const PrefabBlock& block);
+    ModelTemplate& getTemplate(const Model& model);
+    const Mesh& getRotatedTemplate(ModelTemplate& modelTemplate, uint8_t orientation);
+    void bakeTemplate(const Model& model, Mesh& templateMesh);
+    bool getOccluderBounds(const Model& model, int nodeIndex, NodeBounds& bounds) const;
+    void removeHiddenFaces(Mesh& templateMesh, const std::vector<int>& faceNodes,
+        const std::vector<NodeBounds>& occluders) const;
+    const CubeFaces& getCubeFaces(ModelTemplate& modelTemplate, uint8_t orientation);
+    void mapTemplateMaterials(Mesh& outputMesh, ModelTemplate& modelTemplate);
+    void appendCube(Mesh& outputMesh, ModelTemplate& modelTemplate, const CubeFaces& cubeFaces,
+        int32_t worldX, int32_t worldY, int32_t worldZ, uint8_t visibleFaces);
+    void appendTemplate(Mesh& outputMesh, ModelTemplate& modelTemplate,
+        int32_t worldX, int32_t worldY, int32_t worldZ, uint8_t orientation,
+        uint8_t visibleFaces = ExteriorShell::AllFaces);
+    bool isFaceOnCellSide(const Mesh& templateMesh, const MeshFace& face, uint8_t visibleFaces) const;
+
+    void generateBoxNode(Mesh& outputMesh, const Model& model, const ModelNode& node);
+    void generateQuadNode(Mesh& outputMesh, const Model& model, const ModelNode& node);
     void generateBoxFace(Mesh& outputMesh, const Model& model, const ModelNode& node,
-        ModelNode::QuadNormal face, const Mat4& transform, const Vec3& halfSize,
-        int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation);
+        ModelNode::QuadNormal face, const Vec3& halfSize);
     void generateQuadFace(Mesh& outputMesh, const Model& model, const ModelNode& node,
-        ModelNode::QuadNormal normalDir, const Mat4& transform, const Vec2& halfSize,
-        int32_t worldX, int32_t worldY, int32_t worldZ, uint16_t rotation);
+        ModelNode::QuadNormal normalDir, const Vec2& halfSize);
+
+    uint16_t getNodeMaterial(Mesh& templateMesh, const ModelNode& node, uint32_t atlasPage) const;
 
     Mat4 calculateNodeTransform(const Model& model, const ModelNode& node) const;
-    Vec3 transformPoint(const Mat4& matrix, const Vec3& point) const;
-    Vec3 transformNormal(const Mat4& matrix, const Vec3& normal) const;
-    Mat4 extractRotation(const Mat4& matrix) const;
+    void transformVertices(Mesh& mesh, size_t firstVertex, const Mat4& transform);
 
-    bool getAtlasUVs(const ModelFaceTextureLayout& faceLayout, const Vec2& pixelOffset,
-        const Vec3& nodeSize, Vec2& uvMin, Vec2& uvMax) const;
+    // Maps a face's source texture footprint into the packed atlas
+    bool getAtlasUVs(const Model& model, const ModelNode& node, size_t faceIndex,
+        Vec2& uvMin, Vec2& uvMax, uint32_t& atlasPage) const;
 
-    void rotateUVs(Vec2& uv0, Vec2& uv1, Vec2& uv2, Vec2& uv3, int rotation) const;
-    Vec3 rotateVertex(const Vec3& vertex, uint16_t rotation) const;
-    Vec3 rotateNormal(const Vec3& normal, uint16_t rotation) const;
+    // Returns the atlas page the UVs refer to
+    uint32_t applyFaceUVs(Vertex* quad, const Model& model, const ModelNode& node, size_t faceIndex) const;
 
     static const struct FaceOffset {
         int x, y, z;
     } FACE_OFFSETS[6];
-};
\ No newline at end of file
+};
@@ -1,12 +1,23 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 #include "../data/Model.h"
+#include "../util/Parallel.h"
+#include "../output/PNGWriter.h"
+#include "../output/DDSWriter.h"
+#include "../output/MipGenerator.h"
 #include "../output/stb/stb_image.h"
-#include "../output/stb/stb_image_write.h"
 
+int TextureRegistry::addTexture(const std::string& name, const std::string& filepath) {
+	auto existing = textureIds.find(name);
+	if (existing != textureIds.end()) return existing->second;
 
-void TextureRegistry::addTexture(const std::string& name, const std::string& filepath) {
 	int width, height, channels;
 	uint8_t* imageData = stbi_load(filepath.c_str(), &width, &height, &channels, 4);
 
@@ -14,145 +25,598 @@ void TextureRegistry::addTexture(const std::string& name, const std::string& fil
 		throw std::runtime_error("Failed to load texture: " + filepath);
 	}
 
-	textureSources[name] = {
+	return registerTexture(name, imageData, width, height);
+}
+
+void TextureRegistry::addTextures(const std::vector<std::pair<std::string, std::string>>& textures,
+	unsigned int maxDecodes) {
+	std::vector<const std::pair<std::string, std::string>*> pending;
+	std::unordered_set<std::string> pendingNames;
+	for (const auto& texture : textures) {
+		if (textureIds.count(texture.first) == 0 && pendingNames.insert(texture.first).second) {
+			pending.push_back(&texture);
+		}
+	}
+
+	// Each decode writes only its own slot, the thread count bounds how many images
+	// are being decoded at once
+	struct DecodedTexture {
+		uint8_t* data = nullptr;
+		int width = 0, height = 0;
+	};
+	std::vector<DecodedTexture> decoded(pending.size());
+	try {
+		Parallel::forEach(pending.size(), [&](size_t i) {
+			const std::string& filepath = pending[i]->second;
+			int channels;
+			DecodedTexture& texture = decoded[i];
+			texture.data = stbi_load(filepath.c_str(), &texture.width, &texture.height, &channels, 4);
+			if (!texture.data) {
+				throw std::runtime_error("Failed to load texture: " + filepath);
+			}
+		}, maxDecodes);
+	}
+	catch (...) {
+		for (DecodedTexture& texture : decoded) {
+			stbi_image_free(texture.data);
+		}
+		throw;
+	}
+
+	for (size_t i = 0; i < pending.size(); ++i) {
+		registerTexture(pending[i]->first, decoded[i].data, decoded[i].width, decoded[i].height);
+	}
+}
+
+int TextureRegistry::registerTexture(const std::string& name, uint8_t* imageData, int width, int height) {
+	int id = static_cast<int>(textureSources.size());
+	textureSources.push_back({
 		.name = name,
 		.data = imageData,
 		.width = static_cast<unsigned int>(width),
 		.height = static_cast<unsigned int>(height),
-		.channels = 4
-	};
+		.usedRects = {}
+	});
+	textureIds[name] = id;
+	return id;
+}
+
+int TextureRegistry::getTextureId(const std::string& name) const {
+	auto it = textureIds.find(name);
+	return it != textureIds.end() ? it->second : -1;
 }
 
-void TextureRegistry::packTextures() {	
-	// Sort textures from largest to smallest
-	std::vector<TextureSource*> sortedSources;
-	sortedSources.reserve(textureSources.size());
-	for (auto& pair : textureSources) {
-		sortedSources.push_back(&pair.second);
+void TextureRegistry::addUsedRect(int textureId, const TexelRect& rect) {
+	if (textureId < 0 || textureId >= static_cast<int>(textureSources.size())) return;
+	textureSources[textureId].usedRects.push_back(rect);
+}
+
+bool TextureRegistry::getTextureSize(int textureId, uint32_t& outWidth, uint32_t& outHeight) const {
+	if (textureId < 0 || textureId >= static_cast<int>(textureSources.size())) return false;
+	outWidth = textureSources[textureId].width;
+	outHeight = textureSources[textureId].height;
+	return true;
+}
+
+uint64_t TextureRegistry::hashPixels(const uint8_t* data, uint32_t stride, uint32_t width, uint32_t height) {
+	// Multiply-xorshift over 8-byte words, finished with the splitmix64 mixer
+	const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+	uint64_t hash = (static_cast<uint64_t>(width) << 32 | height) * multiplier;
+
+	size_t rowSize = static_cast<size_t>(width) * 4;
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* row = data + static_cast<size_t>(y) * stride;
+		size_t i = 0;
+		for (; i + 8 <= rowSize; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, row + i, 8);
+			hash = (hash ^ word) * multiplier;
+			hash ^= hash >> 29;
+		}
+		// RGBA rows are multiples of 4, so at most one half word is left
+		if (i < rowSize) {
+			uint32_t word;
+			std::memcpy(&word, row + i, 4);
+			hash = (hash ^ word) * multiplier;
+		}
 	}
 
-	std::sort(sortedSources.begin(), sortedSources.end(),
-		[](const TextureSource* a, const TextureSource* b) {
-			// Sort by height first, then width
-			if (a->height != b->height) {
-				return a->height > b->height;
-			}
-			return a->width > b->width;
+	hash ^= hash >> 30;
+	hash *= 0xBF58476D1CE4E5B9ull;
+	hash ^= hash >> 27;
+	hash *= 0x94D049BB133111EBull;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+bool TextureRegistry::insertSkyline(std::vector<SkylineSegment>& skyline, uint32_t atlasWidth, uint32_t atlasHeight,
+	uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY) {
+	size_t bestIndex = SIZE_MAX;
+	uint32_t bestTop = UINT32_MAX;
+	for (size_t i = 0; i < skyline.size(); ++i) {
+		uint32_t x = skyline[i].x;
+		if (x + width > atlasWidth) break;
+
+		uint32_t y = 0;
+		uint32_t spanned = 0;
+		for (size_t j = i; spanned < width; ++j) {
+			y = std::max(y, skyline[j].y);
+			spanned += skyline[j].width;
 		}
-	);
 
-	struct Shelf {
-		uint32_t y;
-		uint32_t height;
-		uint32_t currentX;
+		if (y + height <= atlasHeight && y + height < bestTop) {
+			bestIndex = i;
+			outX = x;
+			outY = y;
+			bestTop = y + height;
+		}
+	}
+
+	if (bestIndex == SIZE_MAX) return false;
+
+	// Raise the skyline under the new texture, trimming the segments it covers
+	SkylineSegment placed = { outX, bestTop, width };
+	skyline.insert(skyline.begin() + bestIndex, placed);
+	size_t next = bestIndex + 1;
+	while (next < skyline.size() && skyline[next].x < placed.x + placed.width) {
+		uint32_t end = skyline[next].x + skyline[next].width;
+		if (end <= placed.x + placed.width) {
+			skyline.erase(skyline.begin() + next);
+			continue;
+		}
+		skyline[next].width = end - (placed.x + placed.width);
+		skyline[next].x = placed.x + placed.width;
+		break;
+	}
+
+	// Merge neighbours at the same height
+	for (size_t i = 0; i + 1 < skyline.size();) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else {
+			++i;
+		}
+	}
+	return true;
+}
+
+std::vector<const TextureRegistry::PackItem*> TextureRegistry::packPage(const std::vector<const PackItem*>& items) {
+	// Blocks take up their gutter on every side
+	uint64_t totalArea = 0;
+	uint32_t widest = 1, tallest = 1;
+	for (const PackItem* item : items) {
+		totalArea += static_cast<uint64_t>(item->rect.width + gutter * 2) * (item->rect.height + gutter * 2);
+		widest = std::max(widest, item->rect.width + gutter * 2);
+		tallest = std::max(tallest, item->rect.height + gutter * 2);
+	}
+
+	// Start from the smallest power-of-two size that holds the largest block and the
+	// total area, then double the shorter side until every block fits
+	uint32_t width = 1, height = 1;
+	while (width < widest) width *= 2;
+	while (height < tallest) height *= 2;
+	auto grow = [&]() {
+		if (width <= height && width < maxAtlasSize) {
+			width *= 2;
+		}
+		else {
+			height *= 2;
+		}
 	};
+	while (static_cast<uint64_t>(width) * height < totalArea && (width < maxAtlasSize || height < maxAtlasSize)) {
+		grow();
+	}
+
+	std::vector<SkylineSegment> skyline;
+	std::vector<Placement> placements;
+	std::vector<const PackItem*> remaining;
+	while (true) {
+		skyline.assign(1, { 0, 0, width });
+		placements.clear();
+		remaining.clear();
 
-	std::vector<Shelf> shelves;
-	uint32_t totalAtlasHeight = 0;
-
-	for (auto& source : sortedSources) {
-		bool placed = false;
-
-		// Try for current shelf
-		for (auto& shelf : shelves) {
-			if (shelf.currentX + source->width <= atlasWidth) {
-				copyTextureToAtlas(source->data, source->width, source->height,
-					source->channels, shelf.currentX, shelf.y);
-
-				textureRegions[source->name] = {
-					.uvMin = Vec2(
-						static_cast<float>(shelf.currentX) / atlasWidth,
-						static_cast<float>(shelf.y) / atlasHeight
-					),
-					.uvMax = Vec2(
-						static_cast<float>(shelf.currentX + source->width) / atlasWidth,
-						static_cast<float>(shelf.y + source->height) / atlasHeight
-					),
-					.pixelWidth = source->width,
-					.pixelHeight = source->height,
-				};
-
-				shelf.currentX += source->width;
-				placed = true;
+		// Once the page is at full size, what does not fit waits for the next page
+		bool fullSize = width == maxAtlasSize && height == maxAtlasSize;
+		for (const PackItem* item : items) {
+			uint32_t x, y;
+			if (insertSkyline(skyline, width, height, item->rect.width + gutter * 2, item->rect.height + gutter * 2, x, y)) {
+				placements.push_back({ item, x + gutter, y + gutter });
+			}
+			else if (fullSize) {
+				remaining.push_back(item);
+			}
+			else {
 				break;
 			}
 		}
 
-		// New shelf
-		if (!placed && (totalAtlasHeight + source->height) < atlasHeight) {
-			Shelf newShelf;
-			newShelf.y = totalAtlasHeight;
-			newShelf.height = source->height;
-			newShelf.currentX = source->width;
+		if (fullSize || placements.size() == items.size()) break;
+		grow();
+	}
 
-			copyTextureToAtlas(source->data, source->width, source->height,
-				source->channels, 0, newShelf.y);
+	uint32_t pageIndex = static_cast<uint32_t>(pages.size());
+	AtlasPage& page = pages.emplace_back();
+	page.width = width;
+	page.height = height;
+	page.pixelData = std::make_unique<uint8_t[]>(static_cast<size_t>(width) * height * 4);
 
-			textureRegions[source->name] = {
-				.uvMin = Vec2(
-					0.0f,
-					static_cast<float>(newShelf.y) / atlasHeight
-				),
-				.uvMax = Vec2(
-					static_cast<float>(source->width) / atlasWidth,
-					static_cast<float>(newShelf.y + source->height) / atlasHeight
-				),
-				.pixelWidth = source->width,
-				.pixelHeight = source->height,
-			};
+	// Placements never overlap, so blocks can be copied in concurrently. Each copy also
+	// notes whether its block has any transparent texels.
+	std::vector<uint8_t> blockTransparent(placements.size(), 0);
+	Parallel::forEach(placements.size(), [&](size_t i) {
+		const Placement& placement = placements[i];
+		const TextureSource* source = placement.item->source;
+		const TexelRect& rect = placement.item->rect;
+		const uint8_t* srcData = source->data + (static_cast<size_t>(rect.y) * source->width + rect.x) * 4;
+		copyTextureToAtlas(page, srcData, source->width, rect.width, rect.height, placement.x, placement.y);
+		if (gutter > 0) {
+			extrudeGutter(page, placement.x, placement.y, rect.width, rect.height);
+		}
 
-			shelves.push_back(newShelf);
-			totalAtlasHeight += source->height;
+		for (uint32_t y = 0; y < rect.height && !blockTransparent[i]; ++y) {
+			const uint8_t* row = page.pixelData.get() + ((static_cast<size_t>(placement.y) + y) * width + placement.x) * 4;
+			for (uint32_t x = 0; x < rect.width; ++x) {
+				if (row[x * 4 + 3] != 255) {
+					blockTransparent[i] = 1;
+					break;
+				}
+			}
 		}
+	});
+	page.opaque = std::find(blockTransparent.begin(), blockTransparent.end(), 1) == blockTransparent.end();
+
+	uint64_t usedArea = 0;
+	for (const Placement& placement : placements) {
+		const TexelRect& rect = placement.item->rect;
+
+		textureRegions[placement.item->textureId].push_back({
+			.uvMin = Vec2(
+				static_cast<float>(placement.x) / width,
+				static_cast<float>(placement.y) / height
+			),
+			.uvMax = Vec2(
+				static_cast<float>(placement.x + rect.width) / width,
+				static_cast<float>(placement.y + rect.height) / height
+			),
+			.pixelWidth = rect.width,
+			.pixelHeight = rect.height,
+			.page = pageIndex,
+			.sourceX = rect.x,
+			.sourceY = rect.y,
+		});
+		usedArea += static_cast<uint64_t>(rect.width) * rect.height;
 	}
 
-	// Clean up sources
-	for (auto it = textureSources.begin(); it != textureSources.end(); ++it) {
-		stbi_image_free(it->second.data);
+	std::cout << "  Packed " << placements.size() << " textures into a " << width << "x" << height
+		<< (pageIndex > 0 ? " atlas page, " : " atlas, ") << std::fixed << std::setprecision(1)
+		<< 100.0 * static_cast<double>(usedArea) / (static_cast<double>(width) * height)
+		<< "% used\n" << std::defaultfloat << std::setprecision(6);
+	return remaining;
+}
+
+void TextureRegistry::mergeRects(std::vector<TexelRect>& rects) {
+	std::vector<size_t> group, slot, active;
+	std::vector<TexelRect> bounds;
+	auto findGroup = [&](size_t i) {
+		while (group[i] != i) {
+			i = group[i] = group[group[i]];
+		}
+		return i;
+	};
+
+	// Each pass sweeps the rectangles left to right, groups the overlapping ones and
+	// replaces every group by its bounds. Grown bounds may overlap again, so passes
+	// repeat until nothing merges.
+	while (rects.size() > 1) {
+		std::sort(rects.begin(), rects.end(), [](const TexelRect& a, const TexelRect& b) { return a.x < b.x; });
+		group.resize(rects.size());
+		std::iota(group.begin(), group.end(), size_t(0));
+		active.clear();
+
+		bool merged = false;
+		for (size_t i = 0; i < rects.size(); ++i) {
+			// Rectangles ending before this one starts cannot reach it or any later one
+			std::erase_if(active, [&](size_t a) { return rects[a].x + rects[a].width <= rects[i].x; });
+			for (size_t a : active) {
+				if (!rects[a].overlaps(rects[i])) continue;
+				group[findGroup(i)] = findGroup(a);
+				merged = true;
+			}
+			active.push_back(i);
+		}
+		if (!merged) return;
+
+		bounds.clear();
+		slot.assign(rects.size(), SIZE_MAX);
+		for (size_t i = 0; i < rects.size(); ++i) {
+			size_t& index = slot[findGroup(i)];
+			if (index == SIZE_MAX) {
+				index = bounds.size();
+				bounds.push_back(rects[i]);
+				continue;
+			}
+
+			TexelRect& box = bounds[index];
+			uint32_t x0 = std::min(box.x, rects[i].x);
+			uint32_t y0 = std::min(box.y, rects[i].y);
+			uint32_t x1 = std::max(box.x + box.width, rects[i].x + rects[i].width);
+			uint32_t y1 = std::max(box.y + box.height, rects[i].y + rects[i].height);
+			box = { x0, y0, x1 - x0, y1 - y0 };
+		}
+		rects.swap(bounds);
 	}
-	textureSources.clear();
 }
 
-void TextureRegistry::copyTextureToAtlas(const uint8_t* srcData, uint32_t srcWidth, uint32_t srcHeight,
-	uint32_t srcChannels, uint32_t dstX, uint32_t dstY) {
+void TextureRegistry::packTextures() {
+	std::vector<PackItem> items;
+	uint64_t sourceArea = 0, trimmedArea = 0;
+	size_t trimmedCount = 0;
+	for (size_t id = 0; id < textureSources.size(); ++id) {
+		TextureSource& source = textureSources[id];
+		if (source.width + gutter * 2 > maxAtlasSize || source.height + gutter * 2 > maxAtlasSize) {
+			std::cerr << "Warning: Texture " << source.name << " is larger than the " << maxAtlasSize
+				<< " pixel atlas limit and was skipped\n";
+			continue;
+		}
 
+		std::vector<TexelRect> rects = std::move(source.usedRects);
+		if (rects.empty()) {
+			rects.push_back({ 0, 0, source.width, source.height });
+		}
+		else {
+			mergeRects(rects);
+			sourceArea += static_cast<uint64_t>(source.width) * source.height;
+			for (const TexelRect& rect : rects) {
+				trimmedArea += static_cast<uint64_t>(rect.width) * rect.height;
+			}
+			++trimmedCount;
+		}
+
+		for (const TexelRect& rect : rects) {
+			const uint8_t* data = source.data + (static_cast<size_t>(rect.y) * source.width + rect.x) * 4;
+			items.push_back({ static_cast<int>(id), &source, rect, hashPixels(data, source.width * 4, rect.width, rect.height) });
+		}
+	}
+
+	// Tallest first, names and positions break ties so the layout does not depend on hash order
+	std::vector<const PackItem*> sortedItems;
+	sortedItems.reserve(items.size());
+	for (const PackItem& item : items) {
+		sortedItems.push_back(&item);
+	}
+	std::sort(sortedItems.begin(), sortedItems.end(),
+		[](const PackItem* a, const PackItem* b) {
+			if (a->rect.height != b->rect.height) {
+				return a->rect.height > b->rect.height;
+			}
+			if (a->rect.width != b->rect.width) {
+				return a->rect.width > b->rect.width;
+			}
+			if (a->source->name != b->source->name) {
+				return a->source->name < b->source->name;
+			}
+			return a->rect.y != b->rect.y ? a->rect.y < b->rect.y : a->rect.x < b->rect.x;
+		}
+	);
+
+	// Pack each distinct block once. Equal hashes are confirmed with a full compare, and
+	// the sort order makes the alphabetically first name the one that gets packed.
+	auto samePixels = [](const PackItem* a, const PackItem* b) {
+		if (a->rect.width != b->rect.width || a->rect.height != b->rect.height) return false;
+		for (uint32_t y = 0; y < a->rect.height; ++y) {
+			const uint8_t* rowA = a->source->data + (static_cast<size_t>(a->rect.y + y) * a->source->width + a->rect.x) * 4;
+			const uint8_t* rowB = b->source->data + (static_cast<size_t>(b->rect.y + y) * b->source->width + b->rect.x) * 4;
+			if (std::memcmp(rowA, rowB, static_cast<size_t>(a->rect.width) * 4) != 0) return false;
+		}
+		return true;
+	};
+	std::unordered_map<uint64_t, std::vector<const PackItem*>> itemsByHash;
+	std::vector<std::pair<const PackItem*, const PackItem*>> duplicates; // Duplicate, packed item
+	size_t uniqueCount = 0;
+	for (const PackItem* item : sortedItems) {
+		std::vector<const PackItem*>& candidates = itemsByHash[item->hash];
+		auto match = std::find_if(candidates.begin(), candidates.end(),
+			[&](const PackItem* other) { return samePixels(item, other); });
+		if (match != candidates.end()) {
+			duplicates.emplace_back(item, *match);
+			continue;
+		}
+		candidates.push_back(item);
+		sortedItems[uniqueCount++] = item;
+	}
+	sortedItems.resize(uniqueCount);
+
+	pages.clear();
+	textureRegions.assign(textureSources.size(), {});
+	do {
+		sortedItems = packPage(sortedItems);
+	} while (!sortedItems.empty());
+
+	for (const auto& [item, packedItem] : duplicates) {
+		const std::vector<AtlasRegion>& packedRegions = textureRegions[packedItem->textureId];
+		for (const AtlasRegion& region : packedRegions) {
+			if (region.sourceX != packedItem->rect.x || region.sourceY != packedItem->rect.y) continue;
+			AtlasRegion shared = region;
+			shared.sourceX = item->rect.x;
+			shared.sourceY = item->rect.y;
+			textureRegions[item->textureId].push_back(shared);
+			break;
+		}
+	}
+	if (!duplicates.empty()) {
+		std::cout << "  Shared " << duplicates.size() << " duplicate textures\n";
+	}
+	if (trimmedCount > 0) {
+		std::cout << "  Trimmed " << trimmedCount << " textures to their used texels, " << std::fixed
+			<< std::setprecision(1) << 100.0 * static_cast<double>(trimmedArea) / static_cast<double>(sourceArea)
+			<< "% of their area\n" << std::defaultfloat << std::setprecision(6);
+	}
+
+	// Free the pixels, sizes stay available
+	for (TextureSource& source : textureSources) {
+		stbi_image_free(source.data);
+		source.data = nullptr;
+	}
+}
+
+void TextureRegistry::copyTextureToAtlas(AtlasPage& page, const uint8_t* srcData, uint32_t srcStride, uint32_t srcWidth,
+	uint32_t srcHeight, uint32_t dstX, uint32_t dstY) {
+
+	size_t srcRowSize = static_cast<size_t>(srcStride) * 4;
 	for (uint32_t y = 0; y < srcHeight; ++y) {
-		for (uint32_t x = 0; x < srcWidth; ++x) {
-			uint32_t srcIdx = (y * srcWidth + x) * srcChannels;
-			uint32_t dstIdx = ((dstY + y) * atlasWidth + (dstX + x)) * 4; //RGBA
+		const uint8_t* srcRow = srcData + y * srcRowSize;
+		uint8_t* dstRow = page.pixelData.get() + ((static_cast<size_t>(dstY) + y) * page.width + dstX) * 4; //RGBA
+		std::memcpy(dstRow, srcRow, static_cast<size_t>(srcWidth) * 4);
+	}
+}
+
+void TextureRegistry::extrudeGutter(AtlasPage& page, uint32_t x, uint32_t y, uint32_t width, uint32_t height) const {
+	size_t stride = static_cast<size_t>(page.width) * 4;
+	uint8_t* pixels = page.pixelData.get();
 
-			pixelData[dstIdx + 0] = srcChannels > 0 ? srcData[srcIdx + 0] : 0;  // R
-			pixelData[dstIdx + 1] = srcChannels > 1 ? srcData[srcIdx + 1] : 0;  // G
-			pixelData[dstIdx + 2] = srcChannels > 2 ? srcData[srcIdx + 2] : 0;  // B
-			pixelData[dstIdx + 3] = srcChannels > 3 ? srcData[srcIdx + 3] : 255; // A
+	for (uint32_t row = y; row < y + height; ++row) {
+		uint8_t* line = pixels + row * stride;
+		const uint8_t* first = line + static_cast<size_t>(x) * 4;
+		const uint8_t* last = line + static_cast<size_t>(x + width - 1) * 4;
+		for (uint32_t i = 1; i <= gutter; ++i) {
+			std::memcpy(line + static_cast<size_t>(x - i) * 4, first, 4);
+			std::memcpy(line + static_cast<size_t>(x + width - 1 + i) * 4, last, 4);
 		}
 	}
+
+	// The top and bottom rows, already widened, also fill the corners
+	size_t spanBytes = static_cast<size_t>(width + gutter * 2) * 4;
+	const uint8_t* top = pixels + y * stride + static_cast<size_t>(x - gutter) * 4;
+	const uint8_t* bottom = pixels + (y + height - 1) * stride + static_cast<size_t>(x - gutter) * 4;
+	for (uint32_t i = 1; i <= gutter; ++i) {
+		std::memcpy(pixels + (y - i) * stride + static_cast<size_t>(x - gutter) * 4, top, spanBytes);
+		std::memcpy(pixels + (y + height - 1 + i) * stride + static_cast<size_t>(x - gutter) * 4, bottom, spanBytes);
+	}
 }
 
-void TextureRegistry::exportAtlas(const std::string& outputPath) const {
-	if (!pixelData) {
+void TextureRegistry::exportAtlas(const std::string& outputPath, uint32_t page, PNGLevel level) const {
+	if (page >= pages.size()) {
 		std::cerr << "Error: Atlas has no pixel data. Call packTextures() first." << std::endl;
 		return;
 	}
 
-	int CHANNELS = 4; //RGBA
-	int stride = atlasWidth * CHANNELS;
+	const AtlasPage& atlasPage = pages[page];
+	if (!PNGWriter::write(outputPath, atlasPage.pixelData.get(), atlasPage.width, atlasPage.height, level)) {
+		std::cerr << "Error: Failed to write PNG file: " << outputPath << std::endl;
+	}
+}
 
-	int result = stbi_write_png(
-		outputPath.c_str(),
-		atlasWidth,
-		atlasHeight,
-		CHANNELS,
-		pixelData.get(),
-		stride
-	);
+std::vector<MipLevel> TextureRegistry::buildMipChain(uint32_t page, MipFilter filter) const {
+	if (page >= pages.size()) return {};
+	return MipGenerator::generate(pages[page].pixelData.get(), pages[page].width, pages[page].height, filter);
+}
 
-	if (!result) {
-		std::cerr << "Error: Failed to write PNG file: " << outputPath << std::endl;
+void TextureRegistry::exportCompressedAtlas(const std::string& outputPath, uint32_t page, const std::vector<MipLevel>& mips,
+	DDSFormat format) const {
+	if (page >= pages.size()) {
+		std::cerr << "Error: Atlas has no pixel data. Call packTextures() first." << std::endl;
+		return;
+	}
+
+	// The writer would see the empty space between blocks as transparent, so pick the
+	// format from the placed texels alone
+	const AtlasPage& atlasPage = pages[page];
+	if (format == DDSFormat::Auto) {
+		format = atlasPage.opaque ? DDSFormat::BC1 : DDSFormat::BC3;
+	}
+	if (!DDSWriter::write(outputPath, atlasPage.pixelData.get(), atlasPage.width, atlasPage.height, mips, format)) {
+		std::cerr << "Error: Failed to write DDS file: " << outputPath << std::endl;
+	}
+}
+
+const uint8_t* TextureRegistry::getRegionPixels(const AtlasRegion& region, uint32_t& stride) const {
+	if (region.page >= pages.size()) return nullptr;
+
+	const AtlasPage& page = pages[region.page];
+	uint32_t startX = static_cast<uint32_t>(region.uvMin.u * page.width + 0.5f);
+	uint32_t startY = static_cast<uint32_t>(region.uvMin.v * page.height + 0.5f);
+	stride = page.width * 4;
+	return page.pixelData.get() + (static_cast<size_t>(startY) * page.width + startX) * 4;
+}
+
+bool TextureRegistry::getAverageColor(const std::string& name, Vec3& outColor) const {
+	int textureId = getTextureId(name);
+	if (textureId < 0 || textureId >= static_cast<int>(textureRegions.size())) return false;
+
+	double sum[3] = { 0.0, 0.0, 0.0 };
+	double alphaSum = 0.0;
+	for (const AtlasRegion& region : textureRegions[textureId]) {
+		uint32_t stride = 0;
+		const uint8_t* pixels = getRegionPixels(region, stride);
+		if (!pixels) continue;
+
+		for (uint32_t y = 0; y < region.pixelHeight; ++y) {
+			const uint8_t* row = pixels + static_cast<size_t>(y) * stride;
+			for (uint32_t x = 0; x < region.pixelWidth; ++x) {
+				double alpha = row[x * 4 + 3];
+				sum[0] += row[x * 4 + 0] * alpha;
+				sum[1] += row[x * 4 + 1] * alpha;
+				sum[2] += row[x * 4 + 2] * alpha;
+				alphaSum += alpha;
+			}
+		}
 	}
+
+	if (alphaSum <= 0.0) return false;
+
+	outColor = Vec3(
+		static_cast<float>(sum[0] / (alphaSum * 255.0)),
+		static_cast<float>(sum[1] / (alphaSum * 255.0)),
+		static_cast<float>(sum[2] / (alphaSum * 255.0)));
+	return true;
+}
+
+bool TextureRegistry::isOpaque(const std::string& name) const {
+	int textureId = getTextureId(name);
+	if (textureId < 0 || textureId >= static_cast<int>(textureRegions.size())) return false;
+	if (textureRegions[textureId].empty()) return false;
+
+	for (const AtlasRegion& region : textureRegions[textureId]) {
+		uint32_t stride = 0;
+		const uint8_t* pixels = getRegionPixels(region, stride);
+		if (!pixels) return false;
+
+		for (uint32_t y = 0; y < region.pixelHeight; ++y) {
+			const uint8_t* row = pixels + static_cast<size_t>(y) * stride;
+			for (uint32_t x = 0; x < region.pixelWidth; ++x) {
+				if (row[x * 4 + 3] != 255) return false;
+			}
+		}
+	}
+	return true;
 }
 
-const AtlasRegion* TextureRegistry::getTextureRegion(const std::string& name) const {
-	auto it = textureRegions.find(name);
-	return (it != textureRegions.end()) ? &it->second : nullptr;
+bool TextureRegistry::isOpaque(int textureId, const TexelRect& rect) const {
+	const AtlasRegion* region = getTextureRegion(textureId, rect);
+	if (!region) return false;
+
+	uint32_t stride = 0;
+	const uint8_t* pixels = getRegionPixels(*region, stride);
+	if (!pixels) return false;
+
+	pixels += static_cast<size_t>(rect.y - region->sourceY) * stride + static_cast<size_t>(rect.x - region->sourceX) * 4;
+	for (uint32_t y = 0; y < rect.height; ++y) {
+		const uint8_t* row = pixels + static_cast<size_t>(y) * stride;
+		for (uint32_t x = 0; x < rect.width; ++x) {
+			if (row[x * 4 + 3] != 255) return false;
+		}
+	}
+	return true;
+}
+
+const AtlasRegion* TextureRegistry::getTextureRegion(int textureId, const TexelRect& rect) const {
+	if (textureId < 0 || textureId >= static_cast<int>(textureRegions.size())) return nullptr;
+
+	for (const AtlasRegion& region : textureRegions[textureId]) {
+		TexelRect packed = { region.sourceX, region.sourceY, region.pixelWidth, region.pixelHeight };
+		if (packed.contains(rect)) return &region;
+	}
+	return nullptr;
 }
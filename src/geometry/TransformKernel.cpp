@@ -0,0 +1,165 @@
+#include "TransformKernel.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRANSFORM_KERNEL_AVX2 1
+#elif defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_KERNEL_SSE 1
+#endif
+
+bool TransformKernel::isOrthonormal(const Mat4& matrix, float epsilon) {
+    for (int i = 0; i < 3; ++i) {
+        for (int j = i; j < 3; ++j) {
+            float dot = matrix.m[0][i] * matrix.m[0][j] + matrix.m[1][i] * matrix.m[1][j] + matrix.m[2][i] * matrix.m[2][j];
+            float expected = (i == j) ? 1.0f : 0.0f;
+            if (std::abs(dot - expected) > epsilon) return false;
+        }
+    }
+    return true;
+}
+
+void TransformKernel::transformPointsScalar(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count) {
+    const auto& m = matrix.m;
+    for (size_t i = 0; i < count; ++i) {
+        float px = x[i], py = y[i], pz = z[i];
+        outX[i] = m[0][0] * px + m[0][1] * py + m[0][2] * pz + m[0][3];
+        outY[i] = m[1][0] * px + m[1][1] * py + m[1][2] * pz + m[1][3];
+        outZ[i] = m[2][0] * px + m[2][1] * py + m[2][2] * pz + m[2][3];
+    }
+}
+
+void TransformKernel::transformNormalsScalar(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count, bool normalize) {
+    const auto& m = matrix.m;
+    for (size_t i = 0; i < count; ++i) {
+        Vec3 n(
+            m[0][0] * x[i] + m[0][1] * y[i] + m[0][2] * z[i],
+            m[1][0] * x[i] + m[1][1] * y[i] + m[1][2] * z[i],
+            m[2][0] * x[i] + m[2][1] * y[i] + m[2][2] * z[i]);
+        if (normalize) {
+            n = n.normalize();
+        }
+        outX[i] = n.x;
+        outY[i] = n.y;
+        outZ[i] = n.z;
+    }
+}
+
+#if defined(TRANSFORM_KERNEL_AVX2)
+
+void TransformKernel::transformPoints(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count) {
+    const auto& m = matrix.m;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        for (int row = 0; row < 3; ++row) {
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[row][0]), px), _mm256_set1_ps(m[row][3]));
+            r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[row][1]), py), r);
+            r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[row][2]), pz), r);
+            _mm256_storeu_ps((row == 0 ? outX : row == 1 ? outY : outZ) + i, r);
+        }
+    }
+    transformPointsScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+void TransformKernel::transformNormals(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count, bool normalize) {
+    const auto& m = matrix.m;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 nx = _mm256_loadu_ps(x + i), ny = _mm256_loadu_ps(y + i), nz = _mm256_loadu_ps(z + i);
+        __m256 r[3];
+        for (int row = 0; row < 3; ++row) {
+            r[row] = _mm256_mul_ps(_mm256_set1_ps(m[row][0]), nx);
+            r[row] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[row][1]), ny), r[row]);
+            r[row] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[row][2]), nz), r[row]);
+        }
+        if (normalize) {
+            // Matches Vec3::normalize, including the +Z fallback for degenerate normals
+            __m256 lengthSq = _mm256_add_ps(_mm256_mul_ps(r[0], r[0]), _mm256_add_ps(_mm256_mul_ps(r[1], r[1]), _mm256_mul_ps(r[2], r[2])));
+            __m256 length = _mm256_sqrt_ps(lengthSq);
+            __m256 degenerate = _mm256_cmp_ps(length, _mm256_set1_ps(1e-6f), _CMP_LT_OQ);
+            __m256 safeLength = _mm256_blendv_ps(length, _mm256_set1_ps(1.0f), degenerate);
+            r[0] = _mm256_blendv_ps(_mm256_div_ps(r[0], safeLength), _mm256_setzero_ps(), degenerate);
+            r[1] = _mm256_blendv_ps(_mm256_div_ps(r[1], safeLength), _mm256_setzero_ps(), degenerate);
+            r[2] = _mm256_blendv_ps(_mm256_div_ps(r[2], safeLength), _mm256_set1_ps(1.0f), degenerate);
+        }
+        _mm256_storeu_ps(outX + i, r[0]);
+        _mm256_storeu_ps(outY + i, r[1]);
+        _mm256_storeu_ps(outZ + i, r[2]);
+    }
+    transformNormalsScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i, normalize);
+}
+
+#elif defined(TRANSFORM_KERNEL_SSE)
+
+void TransformKernel::transformPoints(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count) {
+    const auto& m = matrix.m;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        for (int row = 0; row < 3; ++row) {
+            __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[row][0]), px), _mm_set1_ps(m[row][3]));
+            r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[row][1]), py), r);
+            r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[row][2]), pz), r);
+            _mm_storeu_ps((row == 0 ? outX : row == 1 ? outY : outZ) + i, r);
+        }
+    }
+    transformPointsScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+void TransformKernel::transformNormals(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count, bool normalize) {
+    const auto& m = matrix.m;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 nx = _mm_loadu_ps(x + i), ny = _mm_loadu_ps(y + i), nz = _mm_loadu_ps(z + i);
+        __m128 r[3];
+        for (int row = 0; row < 3; ++row) {
+            r[row] = _mm_mul_ps(_mm_set1_ps(m[row][0]), nx);
+            r[row] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[row][1]), ny), r[row]);
+            r[row] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[row][2]), nz), r[row]);
+        }
+        if (normalize) {
+            // Matches Vec3::normalize, including the +Z fallback for degenerate normals
+            __m128 lengthSq = _mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_add_ps(_mm_mul_ps(r[1], r[1]), _mm_mul_ps(r[2], r[2])));
+            __m128 length = _mm_sqrt_ps(lengthSq);
+            __m128 degenerate = _mm_cmplt_ps(length, _mm_set1_ps(1e-6f));
+            __m128 safeLength = _mm_or_ps(_mm_andnot_ps(degenerate, length), _mm_and_ps(degenerate, _mm_set1_ps(1.0f)));
+            r[0] = _mm_andnot_ps(degenerate, _mm_div_ps(r[0], safeLength));
+            r[1] = _mm_andnot_ps(degenerate, _mm_div_ps(r[1], safeLength));
+            r[2] = _mm_or_ps(_mm_andnot_ps(degenerate, _mm_div_ps(r[2], safeLength)), _mm_and_ps(degenerate, _mm_set1_ps(1.0f)));
+        }
+        _mm_storeu_ps(outX + i, r[0]);
+        _mm_storeu_ps(outY + i, r[1]);
+        _mm_storeu_ps(outZ + i, r[2]);
+    }
+    transformNormalsScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i, normalize);
+}
+
+#else
+
+void TransformKernel::transformPoints(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count) {
+    transformPointsScalar(matrix, x, y, z, outX, outY, outZ, count);
+}
+
+void TransformKernel::transformNormals(const Mat4& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count, bool normalize) {
+    transformNormalsScalar(matrix, x, y, z, outX, outY, outZ, count, normalize);
+}
+
+#endif
+
+void TransformKernel::transform(const Mat4& matrix, VertexStreams& streams) {
+    size_t count = streams.size();
+    transformPoints(matrix, streams.px.data(), streams.py.data(), streams.pz.data(),
+        streams.px.data(), streams.py.data(), streams.pz.data(), count);
+    transformNormals(matrix, streams.nx.data(), streams.ny.data(), streams.nz.data(),
+        streams.nx.data(), streams.ny.data(), streams.nz.data(), count, !isOrthonormal(matrix));
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "../data/Vec.h"
+#include <cstddef>
+#include <vector>
+
+// Structure-of-arrays position and normal streams for batch transforms
+struct VertexStreams {
+	std::vector<float> px, py, pz;
+	std::vector<float> nx, ny, nz;
+
+	size_t size() const { return px.size(); }
+
+	void resize(size_t count) {
+		px.resize(count); py.resize(count); pz.resize(count);
+		nx.resize(count); ny.resize(count); nz.resize(count);
+	}
+};
+
+// Batch Mat4 transforms over SoA streams. Uses AVX2 or SSE when the compiler targets
+// them and falls back to scalar code otherwise. All functions may run in place.
+namespace TransformKernel {
+	// True when the upper 3x3 has unit-length, mutually orthogonal columns, so
+	// transformed normals keep their length and need no renormalization
+	bool isOrthonormal(const Mat4& matrix, float epsilon = 1e-4f);
+
+	void transformPoints(const Mat4& matrix, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count);
+
+	void transformNormals(const Mat4& matrix, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count, bool normalize);
+
+	// Positions by the full matrix, normals by its upper 3x3, normalizing only when the
+	// matrix is not orthonormal
+	void transform(const Mat4& matrix, VertexStreams& streams);
+
+	// Scalar reference path, used for the tail of SIMD loops
+	void transformPointsScalar(const Mat4& matrix, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count);
+	void transformNormalsScalar(const Mat4& matrix, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count, bool normalize);
+}
@@ -0,0 +1,523 @@
+#include "BlockCompressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr int PixelCount = 16;
+    constexpr int RefineIterations = 2;
+
+    const uint8_t BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    const uint8_t BC7Weights2[4] = { 0, 21, 43, 64 };
+
+    // Mean and principal axis of up to 16 points with the given number of channels.
+    // The axis is zero when every point is the same.
+    void fitLine(const float (*points)[4], int count, int channels, float* mean, float* axis) {
+        for (int c = 0; c < channels; ++c) {
+            mean[c] = 0.0f;
+            for (int i = 0; i < count; ++i) mean[c] += points[i][c];
+            mean[c] /= static_cast<float>(count);
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < count; ++i) {
+            for (int a = 0; a < channels; ++a) {
+                for (int b = a; b < channels; ++b) {
+                    covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+                }
+            }
+        }
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < a; ++b) covariance[a][b] = covariance[b][a];
+        }
+
+        // Power iteration, starting from the channel with the largest variance
+        int start = 0;
+        for (int c = 1; c < channels; ++c) {
+            if (covariance[c][c] > covariance[start][start]) start = c;
+        }
+        for (int c = 0; c < channels; ++c) axis[c] = covariance[start][c];
+
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            float length = 0.0f;
+            for (int c = 0; c < channels; ++c) length += axis[c] * axis[c];
+            if (length < 1e-12f) {
+                std::fill(axis, axis + channels, 0.0f);
+                return;
+            }
+            length = std::sqrt(length);
+            float next[4] = {};
+            for (int a = 0; a < channels; ++a) {
+                for (int b = 0; b < channels; ++b) next[a] += covariance[a][b] * axis[b] / length;
+            }
+            std::copy(next, next + channels, axis);
+        }
+
+        float length = 0.0f;
+        for (int c = 0; c < channels; ++c) length += axis[c] * axis[c];
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; ++c) axis[c] = length > 1e-6f ? axis[c] / length : 0.0f;
+    }
+
+    // Ends of the segment along the axis that covers every point
+    void getLineEndpoints(const float (*points)[4], int count, int channels, const float* mean, const float* axis,
+        float* outStart, float* outEnd) {
+        float minimum = 0.0f, maximum = 0.0f;
+        for (int i = 0; i < count; ++i) {
+            float t = 0.0f;
+            for (int c = 0; c < channels; ++c) t += (points[i][c] - mean[c]) * axis[c];
+            minimum = std::min(minimum, t);
+            maximum = std::max(maximum, t);
+        }
+        for (int c = 0; c < channels; ++c) {
+            outStart[c] = std::clamp(mean[c] + axis[c] * minimum, 0.0f, 255.0f);
+            outEnd[c] = std::clamp(mean[c] + axis[c] * maximum, 0.0f, 255.0f);
+        }
+    }
+
+    // Least-squares endpoints for points placed at the given fractions between them.
+    // Returns false when the fractions do not pin down both ends.
+    bool solveEndpoints(const float (*points)[4], const float* weights, int count, int channels,
+        float* outStart, float* outEnd) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float startSum[4] = {}, endSum[4] = {};
+        for (int i = 0; i < count; ++i) {
+            float b = weights[i];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channels; ++c) {
+                startSum[c] += a * points[i][c];
+                endSum[c] += b * points[i][c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f) return false;
+        for (int c = 0; c < channels; ++c) {
+            outStart[c] = std::clamp((bb * startSum[c] - ab * endSum[c]) / determinant, 0.0f, 255.0f);
+            outEnd[c] = std::clamp((aa * endSum[c] - ab * startSum[c]) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    uint16_t packRGB565(const float* color) {
+        uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+        uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+        uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRGB565(uint16_t packed, int* outColor) {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        outColor[0] = (r << 3) | (r >> 2);
+        outColor[1] = (g << 2) | (g >> 4);
+        outColor[2] = (b << 3) | (b >> 2);
+    }
+
+    struct ColorBlock {
+        uint16_t color0 = 0, color1 = 0;
+        uint32_t indices = 0;
+        uint32_t error = UINT32_MAX;
+    };
+
+    // Quantizes the endpoints and picks the nearest palette entry per pixel. Pixels
+    // marked transparent take index 3, which needs the three-colour ordering.
+    ColorBlock evaluateColorBlock(const uint8_t* rgba, const bool* transparent, bool threeColor,
+        const float* start, const float* end) {
+        ColorBlock block;
+        block.color0 = packRGB565(start);
+        block.color1 = packRGB565(end);
+        if (threeColor ? block.color0 > block.color1 : block.color0 < block.color1) {
+            std::swap(block.color0, block.color1);
+        }
+        bool fourColor = block.color0 > block.color1;
+
+        int palette[4][3];
+        unpackRGB565(block.color0, palette[0]);
+        unpackRGB565(block.color1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            if (fourColor) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        // Equal endpoints fall into the three-colour mode, where index 3 means transparent
+        int choices = fourColor ? 4 : 3;
+
+        block.error = 0;
+        for (int i = 0; i < PixelCount; ++i) {
+            if (transparent && transparent[i]) {
+                block.indices |= 3u << (i * 2);
+                continue;
+            }
+            uint32_t bestError = UINT32_MAX;
+            uint32_t bestIndex = 0;
+            for (int index = 0; index < choices; ++index) {
+                uint32_t error = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int difference = rgba[i * 4 + c] - palette[index][c];
+                    error += static_cast<uint32_t>(difference * difference);
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = static_cast<uint32_t>(index);
+                }
+            }
+            block.indices |= bestIndex << (i * 2);
+            block.error += bestError;
+        }
+        return block;
+    }
+
+    void encodeColorBlock(const uint8_t* rgba, bool allowTransparent, uint8_t* outBlock) {
+        bool transparent[PixelCount] = {};
+        float points[PixelCount][4];
+        int count = 0;
+        bool threeColor = false;
+        for (int i = 0; i < PixelCount; ++i) {
+            if (allowTransparent && rgba[i * 4 + 3] < 128) {
+                transparent[i] = true;
+                threeColor = true;
+                continue;
+            }
+            for (int c = 0; c < 3; ++c) points[count][c] = rgba[i * 4 + c];
+            count++;
+        }
+
+        ColorBlock best;
+        if (count == 0) {
+            // Fully transparent, equal endpoints with every index on transparent black
+            best.indices = 0xFFFFFFFFu;
+        }
+        else {
+            float mean[3], axis[3], start[3], end[3];
+            fitLine(points, count, 3, mean, axis);
+            getLineEndpoints(points, count, 3, mean, axis, start, end);
+            best = evaluateColorBlock(rgba, transparent, threeColor, start, end);
+
+            // Fit the endpoints to the chosen indices, for as long as the error drops
+            for (int iteration = 0; iteration < RefineIterations && best.error > 0; ++iteration) {
+                bool fourColor = best.color0 > best.color1;
+                const float fractions[4] = { 0.0f, 1.0f, fourColor ? 1.0f / 3.0f : 0.5f, 2.0f / 3.0f };
+                float weights[PixelCount];
+                for (int i = 0, point = 0; i < PixelCount; ++i) {
+                    if (!transparent[i]) weights[point++] = fractions[(best.indices >> (i * 2)) & 3];
+                }
+
+                float color0[3], color1[3];
+                if (!solveEndpoints(points, weights, count, 3, color0, color1)) break;
+                ColorBlock refined = evaluateColorBlock(rgba, transparent, threeColor, color0, color1);
+                if (refined.error >= best.error) break;
+                best = refined;
+            }
+        }
+
+        outBlock[0] = static_cast<uint8_t>(best.color0);
+        outBlock[1] = static_cast<uint8_t>(best.color0 >> 8);
+        outBlock[2] = static_cast<uint8_t>(best.color1);
+        outBlock[3] = static_cast<uint8_t>(best.color1 >> 8);
+        for (int i = 0; i < 4; ++i) {
+            outBlock[4 + i] = static_cast<uint8_t>(best.indices >> (i * 8));
+        }
+    }
+
+    // Eight-step block between the darkest and brightest alpha, the BC3 and BC4 layout
+    void encodeAlphaBlock(const uint8_t* rgba, uint8_t* outBlock) {
+        int minimum = 255, maximum = 0;
+        for (int i = 0; i < PixelCount; ++i) {
+            minimum = std::min<int>(minimum, rgba[i * 4 + 3]);
+            maximum = std::max<int>(maximum, rgba[i * 4 + 3]);
+        }
+
+        outBlock[0] = static_cast<uint8_t>(maximum);
+        outBlock[1] = static_cast<uint8_t>(minimum);
+        uint64_t indices = 0;
+        if (maximum > minimum) {
+            int range = maximum - minimum;
+            for (int i = 0; i < PixelCount; ++i) {
+                // Step 0 is the maximum and 7 the minimum, stored as indices 0, 2..7, 1
+                int step = ((maximum - rgba[i * 4 + 3]) * 7 + range / 2) / range;
+                uint64_t index = step == 0 ? 0 : step == 7 ? 1 : static_cast<uint64_t>(step + 1);
+                indices |= index << (i * 3);
+            }
+        }
+        for (int i = 0; i < 6; ++i) {
+            outBlock[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    int interpolateBC7(int start, int end, int weight) {
+        return ((64 - weight) * start + weight * end + 32) >> 6;
+    }
+
+    // Mode 6: one RGBA line with 16 steps
+    struct BC7Block {
+        uint8_t endpoints[2][4] = {}; // 7-bit channels
+        uint8_t pbits[2] = {};
+        uint8_t indices[PixelCount] = {};
+        uint32_t error = UINT32_MAX;
+    };
+
+    // Rounds an endpoint to 7 bits per channel, with the shared low bit that fits best
+    // unless fixedPbit is 0 or 1
+    void quantizeBC7Endpoint(const float* color, int fixedPbit, uint8_t* outChannels, uint8_t& outPbit) {
+        uint32_t bestError = UINT32_MAX;
+        for (int pbit = 0; pbit < 2; ++pbit) {
+            if (fixedPbit >= 0 && pbit != fixedPbit) continue;
+            uint8_t channels[4];
+            uint32_t error = 0;
+            for (int c = 0; c < 4; ++c) {
+                int value = static_cast<int>(std::lround((color[c] - pbit) / 2.0f));
+                channels[c] = static_cast<uint8_t>(std::clamp(value, 0, 127));
+                int difference = ((channels[c] << 1) | pbit) - static_cast<int>(color[c] + 0.5f);
+                error += static_cast<uint32_t>(difference * difference);
+            }
+            if (error < bestError) {
+                bestError = error;
+                std::copy(channels, channels + 4, outChannels);
+                outPbit = static_cast<uint8_t>(pbit);
+            }
+        }
+    }
+
+    BC7Block evaluateBC7Block(const uint8_t* rgba, int fixedPbit, const float* start, const float* end) {
+        BC7Block block;
+        quantizeBC7Endpoint(start, fixedPbit, block.endpoints[0], block.pbits[0]);
+        quantizeBC7Endpoint(end, fixedPbit, block.endpoints[1], block.pbits[1]);
+
+        int ends[2][4];
+        for (int e = 0; e < 2; ++e) {
+            for (int c = 0; c < 4; ++c) ends[e][c] = (block.endpoints[e][c] << 1) | block.pbits[e];
+        }
+        int palette[16][4];
+        for (int index = 0; index < 16; ++index) {
+            int weight = BC7Weights[index];
+            for (int c = 0; c < 4; ++c) {
+                palette[index][c] = interpolateBC7(ends[0][c], ends[1][c], weight);
+            }
+        }
+
+        // The palette lies along a line, so project onto it and check the two nearest steps
+        int direction[4];
+        int lengthSquared = 0;
+        for (int c = 0; c < 4; ++c) {
+            direction[c] = ends[1][c] - ends[0][c];
+            lengthSquared += direction[c] * direction[c];
+        }
+
+        block.error = 0;
+        for (int i = 0; i < PixelCount; ++i) {
+            const uint8_t* pixel = rgba + i * 4;
+            int guess = 0;
+            if (lengthSquared > 0) {
+                int dot = 0;
+                for (int c = 0; c < 4; ++c) dot += (pixel[c] - ends[0][c]) * direction[c];
+                float weight = std::clamp(64.0f * static_cast<float>(dot) / static_cast<float>(lengthSquared), 0.0f, 64.0f);
+                guess = static_cast<int>(std::upper_bound(BC7Weights, BC7Weights + 16, static_cast<uint8_t>(weight)) - BC7Weights) - 1;
+            }
+
+            uint32_t bestError = UINT32_MAX;
+            for (int index = guess; index <= std::min(guess + 1, 15); ++index) {
+                uint32_t error = 0;
+                for (int c = 0; c < 4; ++c) {
+                    int difference = pixel[c] - palette[index][c];
+                    error += static_cast<uint32_t>(difference * difference);
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    block.indices[i] = static_cast<uint8_t>(index);
+                }
+            }
+            block.error += bestError;
+        }
+        return block;
+    }
+
+    // Mode 5: an RGB line and a separate alpha line with 4 steps each
+    struct BC7SplitBlock {
+        uint8_t colors[2][3] = {}; // 7-bit channels
+        uint8_t alphas[2] = {};
+        uint8_t colorIndices[PixelCount] = {};
+        uint8_t alphaIndices[PixelCount] = {};
+        uint32_t error = UINT32_MAX;
+    };
+
+    // Quantizes the colour endpoints and picks the nearest colour step per pixel.
+    // Leaves the alpha part alone and counts only colour error.
+    void evaluateBC7SplitColors(const uint8_t* rgba, const float* start, const float* end, BC7SplitBlock& block) {
+        int ends[2][3];
+        for (int c = 0; c < 3; ++c) {
+            block.colors[0][c] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(start[c] * 127.0f / 255.0f)), 0, 127));
+            block.colors[1][c] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(end[c] * 127.0f / 255.0f)), 0, 127));
+            for (int e = 0; e < 2; ++e) ends[e][c] = (block.colors[e][c] << 1) | (block.colors[e][c] >> 6);
+        }
+        int palette[4][3];
+        for (int index = 0; index < 4; ++index) {
+            for (int c = 0; c < 3; ++c) palette[index][c] = interpolateBC7(ends[0][c], ends[1][c], BC7Weights2[index]);
+        }
+
+        block.error = 0;
+        for (int i = 0; i < PixelCount; ++i) {
+            uint32_t bestError = UINT32_MAX;
+            for (int index = 0; index < 4; ++index) {
+                uint32_t error = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int difference = rgba[i * 4 + c] - palette[index][c];
+                    error += static_cast<uint32_t>(difference * difference);
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    block.colorIndices[i] = static_cast<uint8_t>(index);
+                }
+            }
+            block.error += bestError;
+        }
+    }
+
+    BC7SplitBlock encodeBC7Split(const uint8_t* rgba, const float (*points)[4]) {
+        BC7SplitBlock best;
+        float mean[3], axis[3], start[3], end[3];
+        fitLine(points, PixelCount, 3, mean, axis);
+        getLineEndpoints(points, PixelCount, 3, mean, axis, start, end);
+        evaluateBC7SplitColors(rgba, start, end, best);
+
+        for (int iteration = 0; iteration < RefineIterations && best.error > 0; ++iteration) {
+            float weights[PixelCount];
+            for (int i = 0; i < PixelCount; ++i) weights[i] = BC7Weights2[best.colorIndices[i]] / 64.0f;
+            if (!solveEndpoints(points, weights, PixelCount, 3, start, end)) break;
+            BC7SplitBlock refined;
+            evaluateBC7SplitColors(rgba, start, end, refined);
+            if (refined.error >= best.error) break;
+            best = refined;
+        }
+
+        // Alpha endpoints keep all 8 bits, so the extremes are exact
+        int minimum = 255, maximum = 0;
+        for (int i = 0; i < PixelCount; ++i) {
+            minimum = std::min<int>(minimum, rgba[i * 4 + 3]);
+            maximum = std::max<int>(maximum, rgba[i * 4 + 3]);
+        }
+        best.alphas[0] = static_cast<uint8_t>(minimum);
+        best.alphas[1] = static_cast<uint8_t>(maximum);
+        for (int i = 0; i < PixelCount; ++i) {
+            uint32_t bestError = UINT32_MAX;
+            for (int index = 0; index < 4; ++index) {
+                int difference = rgba[i * 4 + 3] - interpolateBC7(minimum, maximum, BC7Weights2[index]);
+                uint32_t error = static_cast<uint32_t>(difference * difference);
+                if (error < bestError) {
+                    bestError = error;
+                    best.alphaIndices[i] = static_cast<uint8_t>(index);
+                }
+            }
+            best.error += bestError;
+        }
+        return best;
+    }
+
+    // Appends fields to a 128-bit block starting from the least significant bit
+    class BlockBitWriter {
+    public:
+        explicit BlockBitWriter(uint8_t* block) : block(block) {
+            std::memset(block, 0, 16);
+        }
+
+        void write(uint32_t value, int count) {
+            for (int bit = 0; bit < count; ++bit, ++position) {
+                block[position / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (position % 8));
+            }
+        }
+
+    private:
+        uint8_t* block;
+        int position = 0;
+    };
+}
+
+void BlockCompressor::encodeBC1(const uint8_t* rgba, uint8_t* outBlock) {
+    encodeColorBlock(rgba, true, outBlock);
+}
+
+void BlockCompressor::encodeBC3(const uint8_t* rgba, uint8_t* outBlock) {
+    encodeAlphaBlock(rgba, outBlock);
+    encodeColorBlock(rgba, false, outBlock + 8);
+}
+
+void BlockCompressor::encodeBC7(const uint8_t* rgba, uint8_t* outBlock) {
+    float points[PixelCount][4];
+    for (int i = 0; i < PixelCount; ++i) {
+        for (int c = 0; c < 4; ++c) points[i][c] = rgba[i * 4 + c];
+    }
+
+    // When alpha is constant, as in opaque blocks, the shared bits must keep it exact
+    int fixedPbit = rgba[3] & 1;
+    for (int i = 1; i < PixelCount; ++i) {
+        if (rgba[i * 4 + 3] != rgba[3]) fixedPbit = -1;
+    }
+
+    float mean[4], axis[4], start[4], end[4];
+    fitLine(points, PixelCount, 4, mean, axis);
+    getLineEndpoints(points, PixelCount, 4, mean, axis, start, end);
+    BC7Block best = evaluateBC7Block(rgba, fixedPbit, start, end);
+
+    for (int iteration = 0; iteration < RefineIterations && best.error > 0; ++iteration) {
+        float weights[PixelCount];
+        for (int i = 0; i < PixelCount; ++i) weights[i] = BC7Weights[best.indices[i]] / 64.0f;
+        if (!solveEndpoints(points, weights, PixelCount, 4, start, end)) break;
+        BC7Block refined = evaluateBC7Block(rgba, fixedPbit, start, end);
+        if (refined.error >= best.error) break;
+        best = refined;
+    }
+
+    BlockBitWriter writer(outBlock);
+
+    // Alpha that does not follow the colour is better kept on its own line
+    if (fixedPbit < 0) {
+        BC7SplitBlock split = encodeBC7Split(rgba, points);
+        if (split.error < best.error) {
+            // Each first index drops its top bit, so it must sit in the lower half
+            if (split.colorIndices[0] >= 2) {
+                std::swap(split.colors[0], split.colors[1]);
+                for (uint8_t& index : split.colorIndices) index = static_cast<uint8_t>(3 - index);
+            }
+            if (split.alphaIndices[0] >= 2) {
+                std::swap(split.alphas[0], split.alphas[1]);
+                for (uint8_t& index : split.alphaIndices) index = static_cast<uint8_t>(3 - index);
+            }
+
+            writer.write(1u << 5, 6); // Mode 5
+            writer.write(0, 2);       // No channel rotation
+            for (int c = 0; c < 3; ++c) {
+                writer.write(split.colors[0][c], 7);
+                writer.write(split.colors[1][c], 7);
+            }
+            writer.write(split.alphas[0], 8);
+            writer.write(split.alphas[1], 8);
+            for (int i = 0; i < PixelCount; ++i) writer.write(split.colorIndices[i], i == 0 ? 1 : 2);
+            for (int i = 0; i < PixelCount; ++i) writer.write(split.alphaIndices[i], i == 0 ? 1 : 2);
+            return;
+        }
+    }
+
+    if (best.indices[0] >= 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (uint8_t& index : best.indices) index = static_cast<uint8_t>(15 - index);
+    }
+
+    writer.write(1u << 6, 7); // Mode 6
+    for (int c = 0; c < 4; ++c) {
+        writer.write(best.endpoints[0][c], 7);
+        writer.write(best.endpoints[1][c], 7);
+    }
+    writer.write(best.pbits[0], 1);
+    writer.write(best.pbits[1], 1);
+    for (int i = 0; i < PixelCount; ++i) {
+        writer.write(best.indices[i], i == 0 ? 3 : 4);
+    }
+}
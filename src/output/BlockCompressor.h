@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+// CPU encoders for 4x4 RGBA blocks in the BCn GPU formats. Each takes the 16 block
+// pixels as 64 bytes in row order and writes one compressed block.
+class BlockCompressor {
+public:
+    static constexpr uint32_t BlockSize = 4;
+
+    // 8 bytes. Blocks with any alpha below 128 use the three-colour mode with
+    // transparent black, all others the four-colour mode.
+    static void encodeBC1(const uint8_t* rgba, uint8_t* outBlock);
+
+    // 16 bytes, an eight-step alpha block followed by a four-colour BC1 block
+    static void encodeBC3(const uint8_t* rgba, uint8_t* outBlock);
+
+    // 16 bytes, single-subset modes only. Mode 6 puts RGBA on one line with 16 steps.
+    // Blocks whose alpha varies also try mode 5, which keeps alpha on a line of its own.
+    static void encodeBC7(const uint8_t* rgba, uint8_t* outBlock);
+};
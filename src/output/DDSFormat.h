@@ -0,0 +1,9 @@
+#pragma once
+
+// Block compression of written DDS textures, kept apart from DDSWriter like PNGLevel
+enum class DDSFormat {
+    Auto, // BC1 when every texel is opaque, BC3 otherwise
+    BC1,  // 4 bits per texel, alpha below 128 becomes transparent black
+    BC3,  // 8 bits per texel with smooth alpha
+    BC7   // 8 bits per texel, higher quality colour and alpha
+};
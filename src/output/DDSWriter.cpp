@@ -0,0 +1,153 @@
+#include "DDSWriter.h"
+#include "BlockCompressor.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+    // Header flags and values from the DDS_HEADER documentation
+    constexpr uint32_t HeaderCaps = 0x1;
+    constexpr uint32_t HeaderHeight = 0x2;
+    constexpr uint32_t HeaderWidth = 0x4;
+    constexpr uint32_t HeaderPixelFormat = 0x1000;
+    constexpr uint32_t HeaderMipMapCount = 0x20000;
+    constexpr uint32_t HeaderLinearSize = 0x80000;
+    constexpr uint32_t PixelFormatFourCC = 0x4;
+    constexpr uint32_t CapsComplex = 0x8;
+    constexpr uint32_t CapsTexture = 0x1000;
+    constexpr uint32_t CapsMipMap = 0x400000;
+    constexpr uint32_t DXGIFormatBC7SRGB = 99;
+    constexpr uint32_t ResourceDimensionTexture2D = 3;
+
+    constexpr uint32_t makeFourCC(char a, char b, char c, char d) {
+        return static_cast<uint32_t>(static_cast<uint8_t>(a)) | (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+    }
+
+    struct EncodedLevel {
+        const uint8_t* pixels;
+        uint32_t width;
+        uint32_t height;
+        size_t dataOffset; // Where the level's blocks start in the output
+    };
+
+    void appendUint32(std::vector<uint8_t>& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+}
+
+bool DDSWriter::parseFormat(const std::string& name, Format& outFormat) {
+    if (name == "auto") outFormat = Format::Auto;
+    else if (name == "bc1") outFormat = Format::BC1;
+    else if (name == "bc3") outFormat = Format::BC3;
+    else if (name == "bc7") outFormat = Format::BC7;
+    else return false;
+    return true;
+}
+
+bool DDSWriter::write(const std::string& filename, const uint8_t* rgba, uint32_t width, uint32_t height,
+    const std::vector<MipLevel>& mips, Format format) {
+    if (!rgba || width == 0 || height == 0) return false;
+
+    if (format == Format::Auto) {
+        bool opaque = true;
+        size_t pixelCount = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < pixelCount && opaque; ++i) {
+            opaque = rgba[i * 4 + 3] == 255;
+        }
+        format = opaque ? Format::BC1 : Format::BC3;
+    }
+    const size_t blockBytes = format == Format::BC1 ? 8 : 16;
+
+    // Levels below 4x4 still take one whole block
+    std::vector<EncodedLevel> levels;
+    levels.push_back({ rgba, width, height, 0 });
+    for (const MipLevel& mip : mips) {
+        levels.push_back({ mip.pixels.data(), mip.width, mip.height, 0 });
+    }
+
+    // One task per row of blocks, across all levels
+    struct BlockRow {
+        const EncodedLevel* level;
+        uint32_t blockY;
+    };
+    std::vector<BlockRow> blockRows;
+    size_t dataSize = 0;
+    for (EncodedLevel& level : levels) {
+        uint32_t blocksWide = (level.width + 3) / 4;
+        uint32_t blocksHigh = (level.height + 3) / 4;
+        level.dataOffset = dataSize;
+        dataSize += static_cast<size_t>(blocksWide) * blocksHigh * blockBytes;
+        for (uint32_t blockY = 0; blockY < blocksHigh; ++blockY) {
+            blockRows.push_back({ &level, blockY });
+        }
+    }
+
+    std::vector<uint8_t> data(dataSize);
+    Parallel::forEach(blockRows.size(), [&](size_t task) {
+        const EncodedLevel& level = *blockRows[task].level;
+        uint32_t blockY = blockRows[task].blockY;
+        uint32_t blocksWide = (level.width + 3) / 4;
+        uint8_t* out = data.data() + level.dataOffset + static_cast<size_t>(blockY) * blocksWide * blockBytes;
+
+        // Blocks past the edge of the level repeat its last row and column
+        uint8_t block[BlockCompressor::BlockSize * BlockCompressor::BlockSize * 4];
+        for (uint32_t blockX = 0; blockX < blocksWide; ++blockX) {
+            for (uint32_t y = 0; y < 4; ++y) {
+                uint32_t sourceY = std::min(blockY * 4 + y, level.height - 1);
+                for (uint32_t x = 0; x < 4; ++x) {
+                    uint32_t sourceX = std::min(blockX * 4 + x, level.width - 1);
+                    std::memcpy(block + (y * 4 + x) * 4, level.pixels + (static_cast<size_t>(sourceY) * level.width + sourceX) * 4, 4);
+                }
+            }
+
+            uint8_t* target = out + blockX * blockBytes;
+            switch (format) {
+            case Format::BC1: BlockCompressor::encodeBC1(block, target); break;
+            case Format::BC3: BlockCompressor::encodeBC3(block, target); break;
+            default: BlockCompressor::encodeBC7(block, target); break;
+            }
+        }
+    });
+
+    std::vector<uint8_t> header;
+    appendUint32(header, makeFourCC('D', 'D', 'S', ' '));
+    appendUint32(header, 124);
+    bool hasMips = levels.size() > 1;
+    appendUint32(header, HeaderCaps | HeaderHeight | HeaderWidth | HeaderPixelFormat | HeaderLinearSize |
+        (hasMips ? HeaderMipMapCount : 0));
+    appendUint32(header, height);
+    appendUint32(header, width);
+    appendUint32(header, static_cast<uint32_t>(hasMips ? levels[1].dataOffset : dataSize));
+    appendUint32(header, 0); // Depth
+    appendUint32(header, static_cast<uint32_t>(levels.size()));
+    for (int i = 0; i < 11; ++i) appendUint32(header, 0);
+
+    appendUint32(header, 32);
+    appendUint32(header, PixelFormatFourCC);
+    appendUint32(header, format == Format::BC1 ? makeFourCC('D', 'X', 'T', '1') :
+        format == Format::BC3 ? makeFourCC('D', 'X', 'T', '5') : makeFourCC('D', 'X', '1', '0'));
+    for (int i = 0; i < 5; ++i) appendUint32(header, 0); // Bit count and masks
+
+    appendUint32(header, CapsTexture | (hasMips ? CapsComplex | CapsMipMap : 0));
+    for (int i = 0; i < 4; ++i) appendUint32(header, 0);
+
+    if (format == Format::BC7) {
+        appendUint32(header, DXGIFormatBC7SRGB);
+        appendUint32(header, ResourceDimensionTexture2D);
+        appendUint32(header, 0); // Misc flags
+        appendUint32(header, 1); // Array size
+        appendUint32(header, 0); // Alpha mode unknown
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "DDSFormat.h"
+#include "MipGenerator.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes RGBA images as block-compressed DDS textures with their mip chain. BC1 and
+// BC3 use the legacy DXT1/DXT5 header, BC7 the DX10 extension header. Blocks are
+// encoded on worker threads, so no GPU is needed.
+// Texels are sRGB. BC7 is tagged BC7_UNORM_SRGB, but the DXT1/DXT5 headers cannot
+// carry a colour space, so loaders must treat those as sRGB themselves.
+class DDSWriter {
+public:
+    using Format = DDSFormat;
+
+    // Accepts "auto", "bc1", "bc3" and "bc7"
+    static bool parseFormat(const std::string& name, Format& outFormat);
+
+    // mips are the levels below the image, as MipGenerator::generate returns them.
+    // Without any only the image itself is written.
+    static bool write(const std::string& filename, const uint8_t* rgba, uint32_t width, uint32_t height,
+        const std::vector<MipLevel>& mips, Format format = Format::Auto);
+};
@@ -0,0 +1,72 @@
+#include "MeshletWriter.h"
+#include <algorithm>
+#include <iostream>
+
+MeshletWriter::MeshletWriter(const std::string& filename) : filename(filename), meshletCount(0) {
+}
+
+bool MeshletWriter::open() {
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open meshlet file: " << filename << std::endl;
+        return false;
+    }
+
+    file.write("HWML", 4);
+    write(Version);
+    write(MeshletBuilder::MaxVertices);
+    write(MeshletBuilder::MaxTriangles);
+    return file.good();
+}
+
+bool MeshletWriter::writeMeshlets(const MeshletData& data, uint64_t vertexOffset, uint64_t faceOffset) {
+    if (data.meshlets.empty()) return true;
+
+    // Vertex indices are stored as uint32, so the OBJ vertices they point at must fit
+    uint32_t maxVertex = *std::max_element(data.vertices.begin(), data.vertices.end());
+    if (vertexOffset + maxVertex > UINT32_MAX) {
+        std::cerr << "Too many vertices for the meshlet file: " << filename << std::endl;
+        return false;
+    }
+
+    write(static_cast<uint32_t>(data.meshlets.size()));
+    write(static_cast<uint32_t>(data.vertices.size()));
+    write(static_cast<uint32_t>(data.triangles.size() / 3));
+
+    for (const auto& meshlet : data.meshlets) {
+        write(static_cast<uint64_t>(meshlet.firstFace + faceOffset));
+        write(meshlet.vertexOffset);
+        write(meshlet.vertexCount);
+        write(meshlet.triangleOffset);
+        write(meshlet.triangleCount);
+        write(meshlet.center.x);
+        write(meshlet.center.y);
+        write(meshlet.center.z);
+        write(meshlet.radius);
+        write(meshlet.coneAxis.x);
+        write(meshlet.coneAxis.y);
+        write(meshlet.coneAxis.z);
+        write(meshlet.coneCutoff);
+    }
+
+    for (uint32_t vertex : data.vertices) {
+        write(static_cast<uint32_t>(vertex + vertexOffset));
+    }
+
+    file.write(reinterpret_cast<const char*>(data.triangles.data()), data.triangles.size());
+    static const char padding[4] = { 0, 0, 0, 0 };
+    file.write(padding, (4 - data.triangles.size() % 4) % 4);
+
+    meshletCount += data.meshlets.size();
+
+    if (!file.good()) {
+        std::cerr << "Failed to write meshlets to " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MeshletWriter::finish() {
+    file.close();
+    return !file.fail();
+}
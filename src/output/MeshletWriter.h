@@ -0,0 +1,40 @@
+#pragma once
+#include "../geometry/MeshletBuilder.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Streams meshlets into a little-endian <name>_meshlets.bin next to the OBJ:
+//   header:  "HWML", uint32 version, uint32 max vertices, uint32 max triangles
+//   records: one per written mesh until end of file
+//     uint32 meshlet count, uint32 vertex count, uint32 triangle count
+//     per meshlet: uint64 first face, uint32 vertex offset, vertex count,
+//       triangle offset, triangle count, float center[3], radius, cone axis[3], cone cutoff
+//     uint32 OBJ vertex index (0-based) per meshlet vertex, so OBJs with meshlets stay
+//       under 2^32 vertices
+//     uint8 local indices, three per triangle, zero padded to 4 bytes
+// Faces and vertices count from the start of the OBJ file, offsets from the start
+// of the record.
+class MeshletWriter {
+public:
+    static constexpr uint32_t Version = 1;
+
+    MeshletWriter(const std::string& filename);
+
+    bool open();
+    // vertexOffset and faceOffset are the OBJ totals written before the mesh
+    bool writeMeshlets(const MeshletData& data, uint64_t vertexOffset, uint64_t faceOffset);
+    bool finish();
+
+    uint64_t getMeshletCount() const { return meshletCount; }
+
+private:
+    std::string filename;
+    std::ofstream file;
+    uint64_t meshletCount;
+
+    template<typename T>
+    void write(const T& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+// Downsampling filter of generated mip levels, kept apart from MipGenerator like PNGLevel
+enum class MipFilter {
+	Box,   // 2x2 average, keeps hard pixel-art edges
+	Kaiser // Kaiser-windowed sinc over 6x6 texels, sharper but may ring slightly
+};
@@ -0,0 +1,191 @@
+#include "MipGenerator.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE
+#endif
+
+namespace {
+	// One source texel of an output texel, offset from twice the output index
+	struct FilterTap {
+		int offset;
+		float weight;
+	};
+
+	constexpr float Pi = 3.14159265358979f;
+	constexpr int LinearSteps = 65535; // Resolution of the linear to sRGB table
+
+	// Zeroth-order modified Bessel function of the first kind, by its power series
+	float besselI0(float x) {
+		float sum = 1.0f, term = 1.0f;
+		for (int k = 1; k < 20; ++k) {
+			term *= (x / (2.0f * k)) * (x / (2.0f * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	std::vector<FilterTap> getTaps(MipGenerator::Filter filter) {
+		if (filter == MipGenerator::Filter::Box) {
+			return { { 0, 0.5f }, { 1, 0.5f } };
+		}
+
+		// Sinc at the output rate, windowed to three output texels with alpha 4.
+		// Source texel 2i + offset sits (offset - 0.5) / 2 output texels from the centre.
+		const float radius = 1.5f, alpha = 4.0f;
+		std::vector<FilterTap> taps;
+		float total = 0.0f;
+		for (int offset = -2; offset <= 3; ++offset) {
+			float distance = (offset - 0.5f) / 2.0f;
+			float sinc = std::sin(Pi * distance) / (Pi * distance);
+			float window = distance / radius;
+			float kaiser = besselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - window * window))) / besselI0(alpha);
+			taps.push_back({ offset, sinc * kaiser });
+			total += sinc * kaiser;
+		}
+		for (FilterTap& tap : taps) {
+			tap.weight /= total;
+		}
+		return taps;
+	}
+
+	const float* getLinearTable() {
+		static const std::vector<float> table = [] {
+			std::vector<float> values(256);
+			for (int i = 0; i < 256; ++i) {
+				float c = i / 255.0f;
+				values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	const uint8_t* getSrgbTable() {
+		static const std::vector<uint8_t> table = [] {
+			std::vector<uint8_t> values(LinearSteps + 1);
+			for (int i = 0; i <= LinearSteps; ++i) {
+				float c = static_cast<float>(i) / LinearSteps;
+				float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+				values[i] = static_cast<uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	// Linear colour premultiplied by alpha, four floats per texel
+	void linearizeRow(const uint8_t* source, uint32_t width, float* out) {
+		const float* linear = getLinearTable();
+		for (uint32_t x = 0; x < width; ++x) {
+			const uint8_t* texel = source + x * 4;
+			float alpha = texel[3] / 255.0f;
+			out[x * 4 + 0] = linear[texel[0]] * alpha;
+			out[x * 4 + 1] = linear[texel[1]] * alpha;
+			out[x * 4 + 2] = linear[texel[2]] * alpha;
+			out[x * 4 + 3] = alpha;
+		}
+	}
+
+	// Adds the horizontally filtered row, scaled by rowWeight, to the accumulated output row
+	void accumulateRow(const float* row, uint32_t sourceWidth, const std::vector<FilterTap>& taps, float rowWeight,
+		float* accumulated, uint32_t width) {
+		int lastTexel = static_cast<int>(sourceWidth) - 1;
+		for (uint32_t x = 0; x < width; ++x) {
+			int center = static_cast<int>(x) * 2;
+#if defined(MIP_GENERATOR_SSE)
+			__m128 sum = _mm_setzero_ps();
+			for (const FilterTap& tap : taps) {
+				int texel = std::clamp(center + tap.offset, 0, lastTexel);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tap.weight), _mm_loadu_ps(row + texel * 4)));
+			}
+			__m128 total = _mm_loadu_ps(accumulated + x * 4);
+			_mm_storeu_ps(accumulated + x * 4, _mm_add_ps(total, _mm_mul_ps(_mm_set1_ps(rowWeight), sum)));
+#else
+			float sum[4] = {};
+			for (const FilterTap& tap : taps) {
+				const float* texel = row + std::clamp(center + tap.offset, 0, lastTexel) * 4;
+				for (int c = 0; c < 4; ++c) sum[c] += tap.weight * texel[c];
+			}
+			for (int c = 0; c < 4; ++c) accumulated[x * 4 + c] += rowWeight * sum[c];
+#endif
+		}
+	}
+
+	// Undoes the alpha weighting and converts back to sRGB bytes
+	void storeRow(const float* accumulated, uint32_t width, uint8_t* out) {
+		const uint8_t* srgb = getSrgbTable();
+		for (uint32_t x = 0; x < width; ++x) {
+			const float* texel = accumulated + x * 4;
+			int steps[4];
+#if defined(MIP_GENERATOR_SSE)
+			__m128 value = _mm_loadu_ps(texel);
+			__m128 alpha = _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+			// Colour over alpha, keeping alpha itself in the last lane
+			__m128 divisor = _mm_max_ps(alpha, _mm_set1_ps(1e-8f));
+			__m128 alphaLane = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+			divisor = _mm_or_ps(_mm_and_ps(alphaLane, _mm_set1_ps(1.0f)), _mm_andnot_ps(alphaLane, divisor));
+			value = _mm_div_ps(value, divisor);
+			value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			__m128 scale = _mm_set_ps(255.0f, LinearSteps, LinearSteps, LinearSteps);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(steps), _mm_cvtps_epi32(_mm_mul_ps(value, scale)));
+#else
+			float alpha = std::clamp(texel[3], 0.0f, 1.0f);
+			for (int c = 0; c < 3; ++c) {
+				float color = alpha > 1e-8f ? texel[c] / std::max(texel[3], 1e-8f) : 0.0f;
+				steps[c] = static_cast<int>(std::lround(std::clamp(color, 0.0f, 1.0f) * LinearSteps));
+			}
+			steps[3] = static_cast<int>(std::lround(alpha * 255.0f));
+#endif
+			out[x * 4 + 0] = srgb[steps[0]];
+			out[x * 4 + 1] = srgb[steps[1]];
+			out[x * 4 + 2] = srgb[steps[2]];
+			out[x * 4 + 3] = static_cast<uint8_t>(steps[3]);
+		}
+	}
+
+	void downsample(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight,
+		const std::vector<FilterTap>& taps, MipLevel& target) {
+		int lastRow = static_cast<int>(sourceHeight) - 1;
+		Parallel::forEach(target.height, [&](size_t y) {
+			std::vector<float> row(static_cast<size_t>(sourceWidth) * 4);
+			std::vector<float> accumulated(static_cast<size_t>(target.width) * 4, 0.0f);
+			for (const FilterTap& tap : taps) {
+				int sourceY = std::clamp(static_cast<int>(y) * 2 + tap.offset, 0, lastRow);
+				linearizeRow(source + static_cast<size_t>(sourceY) * sourceWidth * 4, sourceWidth, row.data());
+				accumulateRow(row.data(), sourceWidth, taps, tap.weight, accumulated.data(), target.width);
+			}
+			storeRow(accumulated.data(), target.width, target.pixels.data() + y * target.width * 4);
+		});
+	}
+}
+
+bool MipGenerator::parseFilter(const std::string& name, Filter& outFilter) {
+	if (name == "box") outFilter = Filter::Box;
+	else if (name == "kaiser") outFilter = Filter::Kaiser;
+	else return false;
+	return true;
+}
+
+std::vector<MipLevel> MipGenerator::generate(const uint8_t* rgba, uint32_t width, uint32_t height, Filter filter) {
+	std::vector<FilterTap> taps = getTaps(filter);
+	std::vector<MipLevel> levels;
+
+	const uint8_t* source = rgba;
+	uint32_t sourceWidth = width, sourceHeight = height;
+	while (sourceWidth > 1 || sourceHeight > 1) {
+		MipLevel& level = levels.emplace_back();
+		level.width = std::max(1u, sourceWidth / 2);
+		level.height = std::max(1u, sourceHeight / 2);
+		level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+		downsample(source, sourceWidth, sourceHeight, taps, level);
+
+		source = level.pixels.data();
+		sourceWidth = level.width;
+		sourceHeight = level.height;
+	}
+	return levels;
+}
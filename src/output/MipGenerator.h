@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MipFilter.h"
+
+struct MipLevel {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> pixels; // RGBA
+};
+
+// Builds mip chains for sRGB RGBA images. Colour is filtered in linear space and
+// weighted by alpha, so transparent texels do not darken the edges of cutouts.
+// Uses SSE when the compiler targets it and falls back to scalar code otherwise.
+class MipGenerator {
+public:
+	using Filter = MipFilter;
+
+	// Accepts "box" and "kaiser"
+	static bool parseFilter(const std::string& name, Filter& outFilter);
+
+	// Every level below the image down to 1x1, each half the size of the one above.
+	// Texels past the edges repeat the edge texel.
+	static std::vector<MipLevel> generate(const uint8_t* rgba, uint32_t width, uint32_t height,
+		Filter filter = Filter::Box);
+};
@@ -1,9 +1,12 @@
 #include "OBJExporter.h"
+#include "PNGWriter.h"
+#include "MipGenerator.h"
+#include "../geometry/BlockRotation.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <unordered_set>
 #include "stb/stb_image.h"
-#include "stb/stb_image_write.h"
 
 bool OBJExporter::exportMesh(const Mesh& mesh, const std::string& filename, 
     const std::string& assetsPath, const TextureRegistry* textureRegistry, const OBJExportOptions& options) {
@@ -18,199 +21,329 @@ bool OBJExporter::exportMeshes(const std::vector<Mesh>& meshes, const std::strin
         return false;
     }
 
+    OBJStreamWriter writer(filename, options);
+    if (!writer.open()) {
+        return false;
+    }
+
+    for (const auto& mesh : meshes) {
+        if (!writer.writeMesh(mesh)) {
+            return false;
+        }
+    }
+
+    return writer.finish(assetsPath, textureRegistry);
+}
+
+std::string OBJExporter::getBaseName(const std::string& filename) {
     std::string baseName = filename;
     if (baseName.size() > 4 && baseName.substr(baseName.size() - 4) == ".obj") {
         baseName = baseName.substr(0, baseName.size() - 4);
     }
+    return baseName;
+}
 
+std::string OBJExporter::getOutputDirectory(const OBJExportOptions& options) {
     // Ensure output directory has trailing slash
     std::string outputDir = options.outputDirectory;
     if (!outputDir.empty() && outputDir.back() != '/' && outputDir.back() != '\\') {
         outputDir += '/';
     }
+    return outputDir;
+}
 
-    std::string objPath = outputDir + baseName + ".obj";
-    std::string mtlFilename = baseName + ".mtl";
-    std::string mtlPath = outputDir + mtlFilename;
+bool OBJExporter::exportInstancedMeshes(const std::vector<Mesh>& templates,
+    const std::vector<std::vector<MeshInstance>>& instances, const std::string& filename,
+    const std::string& assetsPath, const TextureRegistry* textureRegistry, const OBJExportOptions& options) {
+    if (templates.size() != instances.size()) {
+        std::cerr << "Instance lists do not match templates" << std::endl;
+        return false;
+    }
 
-    std::ofstream objFile(objPath);
-    if (!objFile.is_open()) {
-        std::cerr << "Failed to open OBJ file: " << objPath << std::endl;
+    if (!exportMeshes(templates, filename, assetsPath, textureRegistry, options)) {
         return false;
     }
 
-    if (!writeOBJ(objFile, meshes, mtlFilename, options)) {
-        objFile.close();
+    std::string baseName = getBaseName(filename);
+    std::string outputDir = getOutputDirectory(options);
+
+    return writeInstances(outputDir + baseName + "_instances.json", baseName + ".obj", templates, instances);
+}
+
+bool OBJExporter::writeMTL(const std::string& filename,
+    const std::vector<MeshMaterial>& materials,
+    const TextureRegistry* textureRegistry,
+    const OBJExportOptions& options) {
+    std::ofstream mtlFile(filename);
+    if (!mtlFile.is_open()) {
+        std::cerr << "Failed to open MTL file: " << filename << std::endl;
         return false;
     }
-    objFile.close();
 
-    if (options.exportMTL) {
-        if (!writeMTL(mtlPath, meshes, textureRegistry, options)) {
-            return false;
-        }
+    mtlFile << "# Material Library" << std::endl;
+    mtlFile << std::endl;
 
-        if (options.exportTextures) {
-            std::string texturePath = outputDir + baseName + "_atlas.png";
-            if (!exportTextureAtlas(textureRegistry, assetsPath, texturePath)) {
-                std::cerr << "Warning: Failed to export texture atlas" << std::endl;
-            }
+    // Write materials
+    std::string atlasTexture = !options.atlasFilename.empty() ? options.atlasFilename :
+        options.exportTextures ? (filename.substr(0, filename.size() - 4) + "_atlas.png") : "";
+
+    // Extract just the filename from the full path
+    size_t lastSlash = atlasTexture.find_last_of("/\\");
+    std::string texFilename = (lastSlash != std::string::npos) ?
+        atlasTexture.substr(lastSlash + 1) : atlasTexture;
+
+    mtlFile << std::fixed << std::setprecision(3);
+    for (const MeshMaterial& material : materials) {
+        mtlFile << "newmtl " << material.name << std::endl;
+        mtlFile << "Ka 1.000 1.000 1.000" << std::endl;  // Ambient
+        mtlFile << "Kd " << material.diffuse.x << " " << material.diffuse.y << " "
+            << material.diffuse.z << std::endl;           // Diffuse
+        mtlFile << "Ks 0.000 0.000 0.000" << std::endl;  // Specular
+        mtlFile << "d 1.0" << std::endl;                  // Dissolve (opacity)
+        mtlFile << "illum 1" << std::endl;                // Illumination model
+
+        if (material.textured && !texFilename.empty()) {
+            mtlFile << "map_Kd " << getAtlasPageFilename(texFilename, material.atlasPage) << std::endl;
         }
+
+        mtlFile << std::endl;
     }
 
+    mtlFile.close();
     return true;
 }
 
-bool OBJExporter::writeOBJ(std::ofstream& file,
-    const std::vector<Mesh>& meshes,
-    const std::string& mtlFilename,
-    const OBJExportOptions& options) {
-    file << "# Voxel Mesh Export" << std::endl;
-    file << "# Meshes: " << meshes.size() << std::endl;
-    file << std::endl;
-
-    if (options.exportMTL) {
-        file << "mtllib " << mtlFilename << std::endl;
-        file << std::endl;
+bool OBJExporter::writeInstances(const std::string& filename, const std::string& objFilename,
+    const std::vector<Mesh>& templates, const std::vector<std::vector<MeshInstance>>& instances) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open instance file: " << filename << std::endl;
+        return false;
     }
 
-    uint32_t vertexOffset = 0;
+    // Each instance is [x, y, z, orientation]: the template's vertices are moved by -pivot,
+    // multiplied by the orientation's row-major 3x3 matrix, moved back by +pivot and then
+    // offset by the block position. Normals only take the matrix. Template bounds are in
+    // template space, before the orientation is applied.
+    file << "{" << std::endl;
+    file << "  \"mesh\": \"" << objFilename << "\"," << std::endl;
+    file << "  \"instanceLayout\": [\"x\", \"y\", \"z\", \"orientation\"]," << std::endl;
+    file << "  \"pivot\": [0, " << BlockRotation::PivotY << ", 0]," << std::endl;
+    file << "  \"orientations\": [" << std::endl;
+    for (int o = 0; o < BlockRotation::OrientationCount; ++o) {
+        const BlockRotation::Matrix& matrix = BlockRotation::Orientations[o];
+        file << "    [";
+        for (int i = 0; i < 9; ++i) {
+            file << (i == 0 ? "" : ", ") << static_cast<int>(matrix.m[i / 3][i % 3]);
+        }
+        file << "]" << (o + 1 < BlockRotation::OrientationCount ? "," : "") << std::endl;
+    }
+    file << "  ]," << std::endl;
+    file << "  \"templates\": [" << std::endl;
+
+    for (size_t templateIdx = 0; templateIdx < templates.size(); ++templateIdx) {
+        file << "    {" << std::endl;
+        file << "      \"object\": \"" << templates[templateIdx].name << "\"," << std::endl;
+        const Mesh& mesh = templates[templateIdx];
+        if (mesh.hasBounds()) {
+            file << "      \"bounds\": [[" << mesh.minBounds.x << ", " << mesh.minBounds.y << ", " << mesh.minBounds.z
+                << "], [" << mesh.maxBounds.x << ", " << mesh.maxBounds.y << ", " << mesh.maxBounds.z << "]]," << std::endl;
+        }
+        file << "      \"instances\": [";
+
+        const auto& list = instances[templateIdx];
+        for (size_t i = 0; i < list.size(); ++i) {
+            const MeshInstance& instance = list[i];
+            file << (i == 0 ? "" : ",") << (i % 8 == 0 ? "\n        " : " ")
+                << "[" << instance.x << ", " << instance.y << ", " << instance.z << ", "
+                << static_cast<int>(instance.orientation) << "]";
+        }
 
-    for (size_t meshIdx = 0; meshIdx < meshes.size(); ++meshIdx) {
-        const Mesh& mesh = meshes[meshIdx];
+        file << (list.empty() ? "]" : "\n      ]") << std::endl;
+        file << "    }" << (templateIdx + 1 < templates.size() ? "," : "") << std::endl;
+    }
 
-        file << "# Mesh " << (meshIdx + 1) << std::endl;
-        file << "o mesh_" << meshIdx << std::endl;
-        file << std::endl;
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
 
-        // Write vertices
-        file << "# Vertices: " << mesh.vertices.size() << std::endl;
-        for (const auto& vertex : mesh.vertices) {
-            file << "v "
-                << vertex.position.x << " "
-                << vertex.position.y << " "
-                << vertex.position.z << std::endl;
-        }
-        file << std::endl;
+    return file.good();
+}
 
-        // Write texture coordinates
-        file << "# Texture coordinates: " << mesh.vertices.size() << std::endl;
-        for (const auto& vertex : mesh.vertices) {
-            float v = options.flipVCoordinate ? (1.0f - vertex.uv.v) : vertex.uv.v;
-            file << "vt " << vertex.uv.u << " " << v << std::endl;
-        }
-        file << std::endl;
-
-        // Write normals
-        file << "# Normals: " << mesh.vertices.size() << std::endl;
-        for (const auto& vertex : mesh.vertices) {
-            file << "vn "
-                << vertex.normal.x << " "
-                << vertex.normal.y << " "
-                << vertex.normal.z << std::endl;
-        }
-        file << std::endl;
+bool OBJExporter::exportTextureAtlas(const TextureRegistry* textureRegistry, const std::string& assetsPath,
+    const std::string& filename, const OBJExportOptions& options) {
 
-        // Write faces
-        file << "# Faces: " << mesh.faces.size() << std::endl;
-        std::string currentMaterial = "";
+    if (!textureRegistry) {
+        std::cerr << "Error: TextureRegistry is null" << std::endl;
+        return false;
+    }
 
-        for (const auto& face : mesh.faces) {
-            // Switch material if needed
-            if (!face.material.empty() && face.material != currentMaterial) {
-                file << "usemtl " << face.material << std::endl;
-                currentMaterial = face.material;
-            }
-            else if (face.material.empty() && !mesh.materialName.empty() &&
-                mesh.materialName != currentMaterial) {
-                file << "usemtl " << mesh.materialName << std::endl;
-                currentMaterial = mesh.materialName;
-            }
+    for (uint32_t page = 0; page < textureRegistry->getPageCount(); ++page) {
+        std::string pageFilename = getAtlasPageFilename(filename, page);
+        textureRegistry->exportAtlas(pageFilename, page, options.pngLevel);
+        if (!options.exportDDS && !options.exportMips) continue;
 
-            file << "f";
-            for (uint8_t i = 0; i < face.vertexCount; ++i) {
-                uint32_t idx = face.indices[i] + vertexOffset + 1; // OBJ is 1-indexed
-                file << " " << idx << "/" << idx << "/" << idx;
+        std::vector<MipLevel> mips = textureRegistry->buildMipChain(page, options.mipFilter);
+        if (options.exportDDS) {
+            textureRegistry->exportCompressedAtlas(pageFilename.substr(0, pageFilename.rfind('.')) + ".dds",
+                page, mips, options.ddsFormat);
+        }
+        if (options.exportMips) {
+            for (uint32_t level = 1; level <= mips.size(); ++level) {
+                const MipLevel& mip = mips[level - 1];
+                std::string mipFilename = getMipFilename(pageFilename, level);
+                if (!PNGWriter::write(mipFilename, mip.pixels.data(), mip.width, mip.height, options.pngLevel)) {
+                    std::cerr << "Error: Failed to write PNG file: " << mipFilename << std::endl;
+                }
             }
-            file << std::endl;
         }
-        file << std::endl;
+    }
+    return true;
+}
 
-        vertexOffset += static_cast<uint32_t>(mesh.vertices.size());
+std::string OBJExporter::getMipFilename(const std::string& pageFilename, uint32_t level) {
+    size_t extension = pageFilename.rfind('.');
+    if (extension == std::string::npos || pageFilename.find_first_of("/\\", extension) != std::string::npos) {
+        return pageFilename + "_mip" + std::to_string(level);
     }
+    return pageFilename.substr(0, extension) + "_mip" + std::to_string(level) + pageFilename.substr(extension);
+}
 
-    return true;
+std::string OBJExporter::getAtlasPageFilename(const std::string& atlasFilename, uint32_t page) {
+    if (page == 0) return atlasFilename;
+
+    size_t extension = atlasFilename.rfind('.');
+    if (extension == std::string::npos || atlasFilename.find_first_of("/\\", extension) != std::string::npos) {
+        return atlasFilename + std::to_string(page);
+    }
+    return atlasFilename.substr(0, extension) + std::to_string(page) + atlasFilename.substr(extension);
 }
 
-bool OBJExporter::writeMTL(const std::string& filename,
-    const std::vector<Mesh>& meshes,
-    const TextureRegistry* textureRegistry,
-    const OBJExportOptions& options) {
-    std::ofstream mtlFile(filename);
-    if (!mtlFile.is_open()) {
-        std::cerr << "Failed to open MTL file: " << filename << std::endl;
+OBJStreamWriter::OBJStreamWriter(const std::string& filename, const OBJExportOptions& options)
+    : options(options), baseName(OBJExporter::getBaseName(filename)),
+    outputDir(OBJExporter::getOutputDirectory(options)), vertexOffset(0), faceCount(0), meshCount(0),
+    minBounds(FLT_MAX, FLT_MAX, FLT_MAX), maxBounds(-FLT_MAX, -FLT_MAX, -FLT_MAX) {
+}
+
+bool OBJStreamWriter::open() {
+    std::string objPath = outputDir + baseName + ".obj";
+    file.open(objPath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open OBJ file: " << objPath << std::endl;
         return false;
     }
 
-    mtlFile << "# Material Library" << std::endl;
-    mtlFile << std::endl;
+    file << "# Voxel Mesh Export\n";
+    file << "\n";
 
-    // Collect unique materials
-    std::unordered_map<std::string, bool> writtenMaterials;
+    if (options.exportMTL) {
+        file << "mtllib " << baseName << ".mtl\n";
+        file << "\n";
+    }
 
-    for (const auto& mesh : meshes) {
-        // Add mesh-level material
-        if (!mesh.materialName.empty() &&
-            writtenMaterials.find(mesh.materialName) == writtenMaterials.end()) {
-            writtenMaterials[mesh.materialName] = true;
+    return true;
+}
+
+bool OBJStreamWriter::writeMesh(const Mesh& mesh) {
+    size_t meshIdx = meshCount++;
+    minBounds = Vec3::Min(minBounds, mesh.minBounds);
+    maxBounds = Vec3::Max(maxBounds, mesh.maxBounds);
+
+    file << "# Mesh " << (meshIdx + 1) << "\n";
+    if (!mesh.name.empty()) {
+        file << "o " << mesh.name << "\n";
+    }
+    else {
+        file << "o mesh_" << meshIdx << "\n";
+    }
+    file << "\n";
+
+    // Write vertices
+    file << "# Vertices: " << mesh.vertices.size() << "\n";
+    for (const auto& vertex : mesh.vertices) {
+        file << "v "
+            << vertex.position.x << " "
+            << vertex.position.y << " "
+            << vertex.position.z << "\n";
+    }
+    file << "\n";
+
+    // Write texture coordinates
+    file << "# Texture coordinates: " << mesh.vertices.size() << "\n";
+    for (const auto& vertex : mesh.vertices) {
+        float v = options.flipVCoordinate ? (1.0f - vertex.uv.v) : vertex.uv.v;
+        file << "vt " << vertex.uv.u << " " << v << "\n";
+    }
+    file << "\n";
+
+    // Write normals
+    file << "# Normals: " << mesh.vertices.size() << "\n";
+    for (const auto& vertex : mesh.vertices) {
+        file << "vn "
+            << vertex.normal.x << " "
+            << vertex.normal.y << " "
+            << vertex.normal.z << "\n";
+    }
+    file << "\n";
+
+    // Write faces, one usemtl per material range
+    file << "# Faces: " << mesh.faces.size() << "\n";
+    std::vector<MaterialRange> ranges = mesh.materialRanges;
+    if (ranges.empty() && !mesh.faces.empty()) {
+        ranges.push_back({ .material = MeshFace::NoMaterial, .firstFace = 0,
+            .faceCount = static_cast<uint32_t>(mesh.faces.size()) });
+    }
+
+    for (const auto& range : ranges) {
+        MeshMaterial material = range.material == MeshFace::NoMaterial ?
+            MeshMaterial{ .name = mesh.materialName } : mesh.materials[range.material];
+        if (!material.name.empty()) {
+            file << "usemtl " << material.name << "\n";
+            addMaterial(material);
         }
 
-        // Add face-level materials
-        for (const auto& face : mesh.faces) {
-            if (!face.material.empty() &&
-                writtenMaterials.find(face.material) == writtenMaterials.end()) {
-                writtenMaterials[face.material] = true;
+        for (uint32_t faceIdx = range.firstFace; faceIdx < range.firstFace + range.faceCount; ++faceIdx) {
+            const MeshFace& face = mesh.faces[faceIdx];
+            file << "f";
+            for (uint8_t i = 0; i < face.vertexCount; ++i) {
+                uint64_t idx = face.indices[i] + vertexOffset + 1; // OBJ is 1-indexed
+                file << " " << idx << "/" << idx << "/" << idx;
             }
+            file << "\n";
         }
     }
+    file << "\n";
 
-    // Write materials
-    std::string atlasTexture = options.exportTextures ?
-        (filename.substr(0, filename.size() - 4) + "_atlas.png") : "";
+    vertexOffset += mesh.vertices.size();
+    faceCount += mesh.faces.size();
 
-    for (const auto& pair : writtenMaterials) {
-        const std::string& matName = pair.first;
+    if (!file.good()) {
+        std::cerr << "Failed to write OBJ mesh " << (meshIdx + 1) << std::endl;
+        return false;
+    }
+    return true;
+}
 
-        mtlFile << "newmtl " << matName << std::endl;
-        mtlFile << "Ka 1.000 1.000 1.000" << std::endl;  // Ambient
-        mtlFile << "Kd 1.000 1.000 1.000" << std::endl;  // Diffuse
-        mtlFile << "Ks 0.000 0.000 0.000" << std::endl;  // Specular
-        mtlFile << "d 1.0" << std::endl;                  // Dissolve (opacity)
-        mtlFile << "illum 1" << std::endl;                // Illumination model
+bool OBJStreamWriter::finish(const std::string& assetsPath, const TextureRegistry* textureRegistry) {
+    file.close();
 
-        if (!atlasTexture.empty()) {
-            // Extract just the filename from the full path
-            size_t lastSlash = atlasTexture.find_last_of("/\\");
-            std::string texFilename = (lastSlash != std::string::npos) ?
-                atlasTexture.substr(lastSlash + 1) : atlasTexture;
-            mtlFile << "map_Kd " << texFilename << std::endl;
+    if (options.exportMTL) {
+        if (!OBJExporter::writeMTL(outputDir + baseName + ".mtl", materials, textureRegistry, options)) {
+            return false;
         }
 
-        mtlFile << std::endl;
+        if (options.exportTextures && options.atlasFilename.empty()) {
+            std::string texturePath = outputDir + baseName + "_atlas.png";
+            if (!OBJExporter::exportTextureAtlas(textureRegistry, assetsPath, texturePath, options)) {
+                std::cerr << "Warning: Failed to export texture atlas" << std::endl;
+            }
+        }
     }
 
-    mtlFile.close();
     return true;
 }
 
-bool OBJExporter::exportTextureAtlas(const TextureRegistry* textureRegistry, const std::string& assetsPath,
-    const std::string& filename) {
-
-    if (!textureRegistry) {
-        std::cerr << "Error: TextureRegistry is null" << std::endl;
-        return false;
+void OBJStreamWriter::addMaterial(const MeshMaterial& material) {
+    if (seenMaterials.insert(material.name).second) {
+        materials.push_back(material);
     }
-
-    textureRegistry->exportAtlas(filename);
-    return true;
-}
\ No newline at end of file
+}
@@ -1,20 +1,32 @@
 #pragma once
 #include "../data/MeshData.h"
 #include "../data/Model.h"
+#include "PNGLevel.h"
+#include "DDSFormat.h"
+#include "MipFilter.h"
 #include <string>
 #include <fstream>
 #include <vector>
+#include <unordered_set>
+
+struct OBJExportOptions {
+	bool exportMTL = true;
+	bool exportTextures = true;
+	bool flipVCoordinate = true;
+	std::string outputDirectory = "./";
+	std::string atlasFilename; // Existing atlas for the MTL to reference instead of writing one
+	PNGLevel pngLevel = PNGLevel::Default; // Compression of written atlas pages
+	bool exportDDS = false; // Also write each atlas page as a block-compressed DDS
+	DDSFormat ddsFormat = DDSFormat::Auto;
+	bool exportMips = false; // Also write each mip level of the atlas pages as a PNG
+	MipFilter mipFilter = MipFilter::Box; // For both DDS and PNG mips
+
+	OBJExportOptions() = default;
+};
 
 class OBJExporter {
 public:
-	struct OBJExportOptions {
-		bool exportMTL = true;
-		bool exportTextures = true;
-		bool flipVCoordinate = true;
-		std::string outputDirectory = "./";
-
-		OBJExportOptions() = default;
-	};
+	using OBJExportOptions = ::OBJExportOptions;
 
 	static bool exportMesh(const Mesh& mesh, const std::string& filename, 
 		const std::string& assetsPath, const TextureRegistry* textureRegistry,
@@ -24,13 +36,63 @@ public:
 		const std::string& assetsPath, const TextureRegistry* textureRegistry,
 		const OBJExportOptions& options = OBJExportOptions());
 
+	// Writes each template once plus a <name>_instances.json sidecar listing its placements
+	static bool exportInstancedMeshes(const std::vector<Mesh>& templates,
+		const std::vector<std::vector<MeshInstance>>& instances, const std::string& filename,
+		const std::string& assetsPath, const TextureRegistry* textureRegistry,
+		const OBJExportOptions& options = OBJExportOptions());
+
+	// Page 0 keeps the atlas filename, page N > 0 gets N before the extension
+	static std::string getAtlasPageFilename(const std::string& atlasFilename, uint32_t page);
+	// Mip level N > 0 of a page gets _mipN before the extension
+	static std::string getMipFilename(const std::string& pageFilename, uint32_t level);
+
 private:
-	static bool writeOBJ(std::ofstream& file, const std::vector<Mesh>& meshes,
-		const std::string& mtlFilename, const OBJExportOptions& options);
+	friend class OBJStreamWriter;
+
+	static std::string getBaseName(const std::string& filename);
+	static std::string getOutputDirectory(const OBJExportOptions& options);
 
-	static bool writeMTL(const std::string& filename, const std::vector<Mesh>& meshes,
+	static bool writeMTL(const std::string& filename, const std::vector<MeshMaterial>& materials,
 		const TextureRegistry* textureRegistry, const OBJExportOptions& options);
 
+	static bool writeInstances(const std::string& filename, const std::string& objFilename,
+		const std::vector<Mesh>& templates, const std::vector<std::vector<MeshInstance>>& instances);
+
+	// Writes every atlas page next to the OBJ, plus a .dds and mip PNGs beside each when asked
 	static bool exportTextureAtlas(const TextureRegistry* textureRegistry, const std::string& assetsPath,
-		const std::string& filename);
-};
\ No newline at end of file
+		const std::string& filename, const OBJExportOptions& options);
+};
+
+// Writes meshes to one OBJ file as they are produced, so callers never need to hold
+// the whole export in memory. Vertex indices are offset globally across meshes.
+class OBJStreamWriter {
+public:
+	OBJStreamWriter(const std::string& filename, const OBJExportOptions& options = OBJExportOptions());
+
+	bool open();
+	bool writeMesh(const Mesh& mesh);
+	// Closes the OBJ file and writes the MTL and texture atlas
+	bool finish(const std::string& assetsPath, const TextureRegistry* textureRegistry);
+
+	uint64_t getVertexCount() const { return vertexOffset; }
+	uint64_t getFaceCount() const { return faceCount; }
+	// Union of the bounds of every mesh written, empty (min > max) before the first vertex
+	const Vec3& getMinBounds() const { return minBounds; }
+	const Vec3& getMaxBounds() const { return maxBounds; }
+
+private:
+	OBJExportOptions options;
+	std::string baseName;
+	std::string outputDir;
+	std::ofstream file;
+	uint64_t vertexOffset;
+	uint64_t faceCount;
+	size_t meshCount;
+	Vec3 minBounds;
+	Vec3 maxBounds;
+	std::vector<MeshMaterial> materials;
+	std::unordered_set<std::string> seenMaterials;
+
+	void addMaterial(const MeshMaterial& material);
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+// Compression level of written PNGs, kept apart from PNGWriter so headers that only
+// pass a level along do not pull in the writer
+enum class PNGLevel {
+    Store,   // No filtering or compression, for intermediate files
+    Fast,    // Short greedy match searches
+    Default, // Lazy matching with moderate searches
+    Best     // Lazy matching with long searches
+};
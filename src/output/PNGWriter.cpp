@@ -0,0 +1,748 @@
+#include "PNGWriter.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr uint32_t BytesPerPixel = 4;
+    constexpr size_t WindowSize = 32768;
+    constexpr uint32_t MinMatch = 3;
+    constexpr uint32_t MaxMatch = 258;
+    constexpr uint32_t HashBits = 15;
+    constexpr size_t StripBytes = 256 * 1024;  // Filtered bytes deflated per task
+    constexpr size_t BlockTokens = 16384;      // Symbols per deflate block
+    constexpr size_t MaxStoredBlock = 65535;
+
+    // Search limits in the spirit of zlib's configuration table
+    struct LevelParams {
+        uint32_t maxChain;   // Hash chain entries tried per position
+        uint32_t goodLength; // Search a quarter of the chain when trying to beat a match this long
+        uint32_t niceLength; // Stop searching once a match is this long
+        uint32_t lazyLength; // Look one byte ahead for a longer match below this length, 0 for greedy
+    };
+
+    const LevelParams FastParams = { 4, 4, 16, 0 };
+    const LevelParams DefaultParams = { 128, 8, 128, 16 };
+    const LevelParams BestParams = { 1024, 32, MaxMatch, MaxMatch };
+
+    const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    constexpr int LiteralCodes = 286;
+    constexpr int DistanceCodes = 30;
+    constexpr int CodeLengthCodes = 19;
+    constexpr uint16_t EndOfBlock = 256;
+
+    // Literal when distance is 0, otherwise a match of length bytes
+    struct Token {
+        uint16_t length;
+        uint16_t distance;
+    };
+
+    int getLengthCode(uint32_t length) {
+        static const std::vector<uint8_t> codes = [] {
+            std::vector<uint8_t> table(MaxMatch + 1);
+            for (uint32_t value = MinMatch; value <= MaxMatch; ++value) {
+                table[value] = static_cast<uint8_t>(std::upper_bound(LengthBase, LengthBase + 29, value) - LengthBase - 1);
+            }
+            return table;
+        }();
+        return codes[length];
+    }
+
+    // Distances above 256 share codes in runs of 128, so two 256-entry tables cover the window
+    int getDistanceCode(uint32_t distance) {
+        static const std::vector<uint8_t> codes = [] {
+            std::vector<uint8_t> table(512);
+            for (uint32_t value = 1; value <= 256; ++value) {
+                table[value - 1] = static_cast<uint8_t>(std::upper_bound(DistanceBase, DistanceBase + 30, value) - DistanceBase - 1);
+            }
+            for (uint32_t group = 2; group < 256; ++group) {
+                uint32_t value = group * 128 + 1;
+                table[256 + group] = static_cast<uint8_t>(std::upper_bound(DistanceBase, DistanceBase + 30, value) - DistanceBase - 1);
+            }
+            return table;
+        }();
+        return distance <= 256 ? codes[distance - 1] : codes[256 + ((distance - 1) >> 7)];
+    }
+
+    // Number of equal leading bytes, up to limit
+    uint32_t getMatchLength(const uint8_t* a, const uint8_t* b, uint32_t limit) {
+        uint32_t length = 0;
+        if constexpr (std::endian::native == std::endian::little) {
+            for (; length + 8 <= limit; length += 8) {
+                uint64_t wordA, wordB;
+                std::memcpy(&wordA, a + length, 8);
+                std::memcpy(&wordB, b + length, 8);
+                if (wordA != wordB) {
+                    return length + static_cast<uint32_t>(std::countr_zero(wordA ^ wordB) / 8);
+                }
+            }
+        }
+        while (length < limit && a[length] == b[length]) length++;
+        return length;
+    }
+
+    class BitWriter {
+    public:
+        std::vector<uint8_t> bytes;
+
+        // Deflate packs fields starting from the least significant bit
+        void write(uint32_t value, int count) {
+            buffer |= static_cast<uint64_t>(value) << bitCount;
+            bitCount += count;
+            while (bitCount >= 8) {
+                bytes.push_back(static_cast<uint8_t>(buffer));
+                buffer >>= 8;
+                bitCount -= 8;
+            }
+        }
+
+        void alignToByte() {
+            if (bitCount > 0) write(0, 8 - bitCount);
+        }
+
+    private:
+        uint64_t buffer = 0;
+        int bitCount = 0;
+    };
+
+    // Huffman code lengths for the given frequencies, none longer than maxLength
+    void buildLengths(const uint32_t* frequencies, int count, int maxLength, uint8_t* lengths) {
+        std::fill(lengths, lengths + count, 0);
+
+        std::vector<int> symbols;
+        for (int i = 0; i < count; ++i) {
+            if (frequencies[i] > 0) symbols.push_back(i);
+        }
+        if (symbols.empty()) return;
+        if (symbols.size() == 1) {
+            lengths[symbols[0]] = 1;
+            return;
+        }
+        std::stable_sort(symbols.begin(), symbols.end(),
+            [&](int a, int b) { return frequencies[a] < frequencies[b]; });
+
+        // Two-queue Huffman construction: leaves come sorted, merged nodes are created in
+        // increasing weight order, so the two lightest are always at one of the queue fronts
+        size_t leafCount = symbols.size();
+        std::vector<uint64_t> weights(leafCount * 2 - 1);
+        std::vector<int> parents(leafCount * 2 - 1, -1);
+        for (size_t i = 0; i < leafCount; ++i) {
+            weights[i] = frequencies[symbols[i]];
+        }
+        size_t nextLeaf = 0, nextNode = leafCount;
+        for (size_t node = leafCount; node < weights.size(); ++node) {
+            size_t picked[2];
+            for (size_t& pick : picked) {
+                if (nextLeaf < leafCount && (nextNode >= node || weights[nextLeaf] <= weights[nextNode])) {
+                    pick = nextLeaf++;
+                }
+                else {
+                    pick = nextNode++;
+                }
+            }
+            weights[node] = weights[picked[0]] + weights[picked[1]];
+            parents[picked[0]] = parents[picked[1]] = static_cast<int>(node);
+        }
+
+        // Parents always come after their children, so depths fill in from the root down
+        std::vector<int> depths(weights.size(), 0);
+        std::vector<int> lengthCounts(maxLength + 1, 0);
+        for (size_t node = weights.size() - 1; node-- > 0;) {
+            depths[node] = depths[parents[node]] + 1;
+            if (node < leafCount) {
+                lengthCounts[std::min(depths[node], maxLength)]++;
+            }
+        }
+
+        // Clamping raised the Kraft sum above one. Each step drops a longest code and
+        // splits a shorter one into two, lowering the sum by one longest-code unit.
+        uint64_t kraft = 0;
+        for (int length = 1; length <= maxLength; ++length) {
+            kraft += static_cast<uint64_t>(lengthCounts[length]) << (maxLength - length);
+        }
+        while (kraft > (1ull << maxLength)) {
+            lengthCounts[maxLength]--;
+            for (int length = maxLength - 1; length > 0; --length) {
+                if (lengthCounts[length] > 0) {
+                    lengthCounts[length]--;
+                    lengthCounts[length + 1] += 2;
+                    break;
+                }
+            }
+            kraft--;
+        }
+
+        // Longest codes go to the least frequent symbols
+        size_t symbol = 0;
+        for (int length = maxLength; length > 0; --length) {
+            for (int i = 0; i < lengthCounts[length]; ++i) {
+                lengths[symbols[symbol++]] = static_cast<uint8_t>(length);
+            }
+        }
+    }
+
+    // Canonical codes, bit-reversed for the LSB-first writer
+    void buildCodes(const uint8_t* lengths, int count, uint16_t* codes) {
+        int lengthCounts[16] = {};
+        for (int i = 0; i < count; ++i) {
+            lengthCounts[lengths[i]]++;
+        }
+        lengthCounts[0] = 0;
+
+        uint32_t nextCode[16] = {};
+        uint32_t code = 0;
+        for (int bits = 1; bits < 16; ++bits) {
+            code = (code + lengthCounts[bits - 1]) << 1;
+            nextCode[bits] = code;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int length = lengths[i];
+            if (length == 0) continue;
+            uint32_t value = nextCode[length]++;
+            uint32_t reversed = 0;
+            for (int bit = 0; bit < length; ++bit) {
+                reversed = (reversed << 1) | ((value >> bit) & 1);
+            }
+            codes[i] = static_cast<uint16_t>(reversed);
+        }
+    }
+
+    // Makes sure at least two symbols get codes, as inflaters reject some one-code trees
+    void ensureTwoSymbols(uint32_t* frequencies, int count) {
+        int used = 0;
+        for (int i = 0; i < count && used < 2; ++i) {
+            if (frequencies[i] > 0) used++;
+        }
+        for (int i = 0; i < count && used < 2; ++i) {
+            if (frequencies[i] == 0) {
+                frequencies[i] = 1;
+                used++;
+            }
+        }
+    }
+
+    void writeStoredBlocks(BitWriter& out, const uint8_t* raw, size_t size, bool final) {
+        size_t offset = 0;
+        do {
+            size_t length = std::min(size - offset, MaxStoredBlock);
+            bool last = offset + length == size;
+            out.write(final && last ? 1 : 0, 1);
+            out.write(0, 2);
+            out.alignToByte();
+            out.write(static_cast<uint32_t>(length), 16);
+            out.write(static_cast<uint32_t>(~length & 0xFFFF), 16);
+            out.bytes.insert(out.bytes.end(), raw + offset, raw + offset + length);
+            offset += length;
+        } while (offset < size);
+    }
+
+    void writeTokens(BitWriter& out, const std::vector<Token>& tokens, const uint8_t* literalLengths,
+        const uint16_t* literalCodes, const uint8_t* distanceLengths, const uint16_t* distanceCodes) {
+        for (const Token& token : tokens) {
+            if (token.distance == 0) {
+                out.write(literalCodes[token.length], literalLengths[token.length]);
+                continue;
+            }
+            int lengthCode = getLengthCode(token.length);
+            out.write(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+            out.write(token.length - LengthBase[lengthCode], LengthExtra[lengthCode]);
+            int distanceCode = getDistanceCode(token.distance);
+            out.write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+            out.write(token.distance - DistanceBase[distanceCode], DistanceExtra[distanceCode]);
+        }
+        out.write(literalCodes[EndOfBlock], literalLengths[EndOfBlock]);
+    }
+
+    // Writes tokens as whichever of a dynamic, fixed or stored block is smallest.
+    // raw holds the bytes the tokens decode to.
+    void writeBlock(BitWriter& out, const std::vector<Token>& tokens, const uint8_t* raw, size_t rawSize, bool final) {
+        uint32_t literalFrequencies[LiteralCodes] = {};
+        uint32_t distanceFrequencies[DistanceCodes] = {};
+        uint64_t extraBits = 0;
+        for (const Token& token : tokens) {
+            if (token.distance == 0) {
+                literalFrequencies[token.length]++;
+                continue;
+            }
+            int lengthCode = getLengthCode(token.length);
+            int distanceCode = getDistanceCode(token.distance);
+            literalFrequencies[257 + lengthCode]++;
+            distanceFrequencies[distanceCode]++;
+            extraBits += LengthExtra[lengthCode] + DistanceExtra[distanceCode];
+        }
+        literalFrequencies[EndOfBlock] = 1;
+
+        // Fixed codes from RFC 1951 3.2.6
+        uint8_t fixedLiteralLengths[288];
+        std::fill(fixedLiteralLengths, fixedLiteralLengths + 144, 8);
+        std::fill(fixedLiteralLengths + 144, fixedLiteralLengths + 256, 9);
+        std::fill(fixedLiteralLengths + 256, fixedLiteralLengths + 280, 7);
+        std::fill(fixedLiteralLengths + 280, fixedLiteralLengths + 288, 8);
+        uint8_t fixedDistanceLengths[DistanceCodes];
+        std::fill(fixedDistanceLengths, fixedDistanceLengths + DistanceCodes, 5);
+
+        uint64_t fixedBits = 3 + extraBits;
+        for (int i = 0; i < LiteralCodes; ++i) fixedBits += static_cast<uint64_t>(literalFrequencies[i]) * fixedLiteralLengths[i];
+        for (int i = 0; i < DistanceCodes; ++i) fixedBits += static_cast<uint64_t>(distanceFrequencies[i]) * 5;
+
+        ensureTwoSymbols(literalFrequencies, LiteralCodes);
+        ensureTwoSymbols(distanceFrequencies, DistanceCodes);
+        uint8_t literalLengths[LiteralCodes], distanceLengths[DistanceCodes];
+        buildLengths(literalFrequencies, LiteralCodes, 15, literalLengths);
+        buildLengths(distanceFrequencies, DistanceCodes, 15, distanceLengths);
+
+        int literalCount = LiteralCodes;
+        while (literalCount > 257 && literalLengths[literalCount - 1] == 0) literalCount--;
+        int distanceCount = DistanceCodes;
+        while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) distanceCount--;
+
+        // Run-length code the two length tables as one sequence
+        std::vector<uint8_t> allLengths(literalLengths, literalLengths + literalCount);
+        allLengths.insert(allLengths.end(), distanceLengths, distanceLengths + distanceCount);
+        std::vector<std::pair<uint8_t, uint8_t>> runs; // Code length symbol, extra bits value
+        uint32_t codeLengthFrequencies[CodeLengthCodes] = {};
+        for (size_t i = 0; i < allLengths.size();) {
+            uint8_t length = allLengths[i];
+            size_t run = 1;
+            while (i + run < allLengths.size() && allLengths[i + run] == length) run++;
+
+            size_t remaining = run;
+            if (length == 0) {
+                while (remaining >= 11) {
+                    size_t count = std::min<size_t>(remaining, 138);
+                    runs.push_back({ 18, static_cast<uint8_t>(count - 11) });
+                    remaining -= count;
+                }
+                if (remaining >= 3) {
+                    runs.push_back({ 17, static_cast<uint8_t>(remaining - 3) });
+                    remaining = 0;
+                }
+            }
+            else {
+                runs.push_back({ length, 0 });
+                remaining--;
+                while (remaining >= 3) {
+                    size_t count = std::min<size_t>(remaining, 6);
+                    runs.push_back({ 16, static_cast<uint8_t>(count - 3) });
+                    remaining -= count;
+                }
+            }
+            for (; remaining > 0; --remaining) {
+                runs.push_back({ length, 0 });
+            }
+            i += run;
+        }
+        for (const auto& entry : runs) {
+            codeLengthFrequencies[entry.first]++;
+        }
+        ensureTwoSymbols(codeLengthFrequencies, CodeLengthCodes);
+        uint8_t codeLengthLengths[CodeLengthCodes];
+        buildLengths(codeLengthFrequencies, CodeLengthCodes, 7, codeLengthLengths);
+        int codeLengthCount = CodeLengthCodes;
+        while (codeLengthCount > 4 && codeLengthLengths[CodeLengthOrder[codeLengthCount - 1]] == 0) codeLengthCount--;
+
+        uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * static_cast<uint64_t>(codeLengthCount) + extraBits;
+        for (const auto& entry : runs) {
+            dynamicBits += codeLengthLengths[entry.first];
+            dynamicBits += entry.first == 16 ? 2 : entry.first == 17 ? 3 : entry.first == 18 ? 7 : 0;
+        }
+        for (const Token& token : tokens) {
+            if (token.distance == 0) {
+                dynamicBits += literalLengths[token.length];
+            }
+            else {
+                dynamicBits += literalLengths[257 + getLengthCode(token.length)];
+                dynamicBits += distanceLengths[getDistanceCode(token.distance)];
+            }
+        }
+        dynamicBits += literalLengths[EndOfBlock];
+
+        uint64_t storedBits = rawSize * 8 + (rawSize / MaxStoredBlock + 1) * (3 + 7 + 32);
+
+        if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+            writeStoredBlocks(out, raw, rawSize, final);
+            return;
+        }
+
+        out.write(final ? 1 : 0, 1);
+        if (fixedBits <= dynamicBits) {
+            out.write(1, 2);
+            uint16_t fixedLiteralCodes[288], fixedDistanceCodes[DistanceCodes];
+            buildCodes(fixedLiteralLengths, 288, fixedLiteralCodes);
+            buildCodes(fixedDistanceLengths, DistanceCodes, fixedDistanceCodes);
+            writeTokens(out, tokens, fixedLiteralLengths, fixedLiteralCodes, fixedDistanceLengths, fixedDistanceCodes);
+            return;
+        }
+
+        out.write(2, 2);
+        out.write(literalCount - 257, 5);
+        out.write(distanceCount - 1, 5);
+        out.write(codeLengthCount - 4, 4);
+        for (int i = 0; i < codeLengthCount; ++i) {
+            out.write(codeLengthLengths[CodeLengthOrder[i]], 3);
+        }
+        uint16_t codeLengthCodes[CodeLengthCodes];
+        buildCodes(codeLengthLengths, CodeLengthCodes, codeLengthCodes);
+        for (const auto& entry : runs) {
+            out.write(codeLengthCodes[entry.first], codeLengthLengths[entry.first]);
+            if (entry.first == 16) out.write(entry.second, 2);
+            else if (entry.first == 17) out.write(entry.second, 3);
+            else if (entry.first == 18) out.write(entry.second, 7);
+        }
+
+        uint16_t literalCodes[LiteralCodes], distanceCodes[DistanceCodes];
+        buildCodes(literalLengths, LiteralCodes, literalCodes);
+        buildCodes(distanceLengths, DistanceCodes, distanceCodes);
+        writeTokens(out, tokens, literalLengths, literalCodes, distanceLengths, distanceCodes);
+    }
+
+    // Deflates data[dictionarySize, size). The bytes before it only serve as match history.
+    // Strips other than the last end on an empty stored block, leaving the stream byte
+    // aligned and open for the next strip.
+    std::vector<uint8_t> deflateStrip(const uint8_t* data, size_t dictionarySize, size_t size,
+        const LevelParams* params, bool last) {
+        BitWriter out;
+        if (!params) {
+            writeStoredBlocks(out, data + dictionarySize, size - dictionarySize, last);
+            return std::move(out.bytes);
+        }
+
+        std::vector<int32_t> head(size_t(1) << HashBits, -1);
+        std::vector<int32_t> previous(size, -1);
+        auto hash = [&](size_t position) {
+            uint32_t value = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16);
+            return (value * 2654435761u) >> (32 - HashBits);
+        };
+        auto insert = [&](size_t position) {
+            if (position + MinMatch > size) return;
+            uint32_t bucket = hash(position);
+            previous[position] = head[bucket];
+            head[bucket] = static_cast<int32_t>(position);
+        };
+        // Longest match at position that beats the given length, 0 when there is none
+        auto findMatch = [&](size_t position, uint32_t beat, uint32_t& outDistance) -> uint32_t {
+            uint32_t limit = static_cast<uint32_t>(std::min<size_t>(MaxMatch, size - position));
+            if (limit < MinMatch) return 0;
+
+            uint32_t best = std::max(beat, MinMatch - 1);
+            if (best >= limit) return 0;
+            uint32_t chain = beat >= params->goodLength ? params->maxChain / 4 + 1 : params->maxChain;
+            for (int32_t candidate = head[hash(position)];
+                candidate >= 0 && position - candidate <= WindowSize && chain-- > 0;
+                candidate = previous[candidate]) {
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + position;
+                if (a[best] != b[best] || a[0] != b[0]) continue;
+
+                uint32_t length = getMatchLength(a, b, limit);
+                if (length > best) {
+                    best = length;
+                    outDistance = static_cast<uint32_t>(position - candidate);
+                    if (length >= params->niceLength || length == limit) break;
+                }
+            }
+            return best > std::max(beat, MinMatch - 1) ? best : 0;
+        };
+
+        for (size_t position = 0; position < dictionarySize; ++position) {
+            insert(position);
+        }
+
+        std::vector<Token> tokens;
+        tokens.reserve(BlockTokens);
+        size_t blockStart = dictionarySize;
+        size_t position = dictionarySize;
+        size_t cachedPosition = SIZE_MAX;
+        uint32_t cachedLength = 0, cachedDistance = 0;
+        while (position < size) {
+            uint32_t distance = 0;
+            uint32_t length;
+            if (cachedPosition == position) {
+                length = cachedLength;
+                distance = cachedDistance;
+            }
+            else {
+                length = findMatch(position, 0, distance);
+            }
+            insert(position);
+
+            if (length > 0 && length < params->lazyLength && position + 1 < size) {
+                cachedPosition = position + 1;
+                cachedLength = findMatch(position + 1, length, cachedDistance);
+                if (cachedLength > 0) length = 0;
+            }
+
+            if (length > 0) {
+                tokens.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+                for (size_t i = 1; i < length; ++i) {
+                    insert(position + i);
+                }
+                position += length;
+            }
+            else {
+                tokens.push_back({ data[position], 0 });
+                position++;
+            }
+
+            if (tokens.size() >= BlockTokens) {
+                writeBlock(out, tokens, data + blockStart, position - blockStart, false);
+                tokens.clear();
+                blockStart = position;
+            }
+        }
+        writeBlock(out, tokens, data + blockStart, size - blockStart, last);
+
+        if (last) {
+            out.alignToByte();
+        }
+        else {
+            writeStoredBlocks(out, nullptr, 0, false);
+        }
+        return std::move(out.bytes);
+    }
+
+    uint8_t paeth(uint8_t left, uint8_t up, uint8_t upLeft) {
+        int estimate = left + up - upLeft;
+        int distanceLeft = std::abs(estimate - left);
+        int distanceUp = std::abs(estimate - up);
+        int distanceUpLeft = std::abs(estimate - upLeft);
+        if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) return left;
+        return distanceUp <= distanceUpLeft ? up : upLeft;
+    }
+
+    // Applies one PNG filter to a row, with zeros standing in for bytes left of the
+    // row and for the row above the first
+    template <typename Predictor>
+    void applyFilter(const uint8_t* row, const uint8_t* above, size_t rowSize, uint8_t* out, Predictor predict) {
+        for (size_t i = 0; i < BytesPerPixel && i < rowSize; ++i) {
+            out[i] = static_cast<uint8_t>(row[i] - predict(0, above[i], 0));
+        }
+        for (size_t i = BytesPerPixel; i < rowSize; ++i) {
+            out[i] = static_cast<uint8_t>(row[i] - predict(row[i - BytesPerPixel], above[i], above[i - BytesPerPixel]));
+        }
+    }
+
+    // Writes the filter type byte and filtered row to out. Picks the filter with the
+    // smallest sum of absolute signed bytes, unless choose is false.
+    void filterRow(const uint8_t* row, const uint8_t* above, size_t rowSize, bool choose, uint8_t* out,
+        std::vector<uint8_t>& scratch) {
+        if (!choose) {
+            out[0] = 0;
+            std::memcpy(out + 1, row, rowSize);
+            return;
+        }
+
+        if (!above) {
+            scratch.assign(rowSize * 6, 0);
+            above = scratch.data() + rowSize * 5;
+        }
+        else {
+            scratch.resize(rowSize * 5);
+        }
+        uint8_t* candidates = scratch.data();
+        std::memcpy(candidates, row, rowSize);
+        applyFilter(row, above, rowSize, candidates + rowSize,
+            [](uint8_t left, uint8_t, uint8_t) { return left; });
+        applyFilter(row, above, rowSize, candidates + rowSize * 2,
+            [](uint8_t, uint8_t up, uint8_t) { return up; });
+        applyFilter(row, above, rowSize, candidates + rowSize * 3,
+            [](uint8_t left, uint8_t up, uint8_t) { return static_cast<uint8_t>((left + up) >> 1); });
+        applyFilter(row, above, rowSize, candidates + rowSize * 4,
+            [](uint8_t left, uint8_t up, uint8_t upLeft) { return paeth(left, up, upLeft); });
+
+        uint8_t bestType = 0;
+        uint64_t bestScore = UINT64_MAX;
+        for (uint8_t type = 0; type < 5; ++type) {
+            const uint8_t* candidate = candidates + rowSize * type;
+            uint64_t score = 0;
+            for (size_t i = 0; i < rowSize; ++i) {
+                score += static_cast<uint8_t>(std::abs(static_cast<int8_t>(candidate[i])));
+            }
+            if (score < bestScore) {
+                bestScore = score;
+                bestType = type;
+            }
+        }
+        out[0] = bestType;
+        std::memcpy(out + 1, candidates + rowSize * bestType, rowSize);
+    }
+
+    uint32_t adler32(const uint8_t* data, size_t size) {
+        const uint32_t modulus = 65521;
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            // 5552 bytes is the most that can be summed before b overflows 32 bits
+            size_t count = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < count; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= modulus;
+            b %= modulus;
+            data += count;
+            size -= count;
+        }
+        return (b << 16) | a;
+    }
+
+    // Checksum of two sequences joined, from their checksums and the second's length
+    uint32_t combineAdler32(uint32_t first, uint32_t second, size_t secondSize) {
+        const uint32_t modulus = 65521;
+        uint32_t remainder = static_cast<uint32_t>(secondSize % modulus);
+        uint32_t sum1 = first & 0xFFFF;
+        uint32_t sum2 = (remainder * sum1) % modulus;
+        sum1 += (second & 0xFFFF) + modulus - 1;
+        sum2 += (first >> 16) + (second >> 16) + modulus - remainder;
+        if (sum1 >= modulus) sum1 -= modulus;
+        if (sum1 >= modulus) sum1 -= modulus;
+        if (sum2 >= modulus * 2) sum2 -= modulus * 2;
+        if (sum2 >= modulus) sum2 -= modulus;
+        return sum1 | (sum2 << 16);
+    }
+
+    uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                }
+                entries[i] = value;
+            }
+            return entries;
+        }();
+
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Writes one chunk whose data is the concatenation of parts
+    void writeChunk(std::ofstream& file, const char* type, const std::vector<std::pair<const uint8_t*, size_t>>& parts) {
+        size_t length = 0;
+        for (const auto& part : parts) length += part.second;
+
+        std::vector<uint8_t> header;
+        appendBigEndian(header, static_cast<uint32_t>(length));
+        header.insert(header.end(), type, type + 4);
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+        uint32_t crc = updateCrc32(0xFFFFFFFFu, header.data() + 4, 4);
+        for (const auto& part : parts) {
+            file.write(reinterpret_cast<const char*>(part.first), part.second);
+            crc = updateCrc32(crc, part.first, part.second);
+        }
+
+        std::vector<uint8_t> footer;
+        appendBigEndian(footer, crc ^ 0xFFFFFFFFu);
+        file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+    }
+}
+
+bool PNGWriter::parseLevel(const std::string& name, Level& outLevel) {
+    if (name == "store") outLevel = Level::Store;
+    else if (name == "fast") outLevel = Level::Fast;
+    else if (name == "default") outLevel = Level::Default;
+    else if (name == "best") outLevel = Level::Best;
+    else return false;
+    return true;
+}
+
+bool PNGWriter::write(const std::string& filename, const uint8_t* rgba, uint32_t width, uint32_t height, Level level) {
+    if (!rgba || width == 0 || height == 0) return false;
+
+    const LevelParams* params = level == Level::Fast ? &FastParams :
+        level == Level::Default ? &DefaultParams :
+        level == Level::Best ? &BestParams : nullptr;
+
+    // Strips cover whole rows. Filtering only looks at the raw row above, so each strip
+    // filters its own rows plus the ones before it that fall inside the match window.
+    const size_t rowSize = static_cast<size_t>(width) * BytesPerPixel;
+    const size_t filteredRowSize = rowSize + 1;
+    const uint32_t stripRows = static_cast<uint32_t>(std::max<size_t>(1, StripBytes / filteredRowSize));
+    const uint32_t windowRows = static_cast<uint32_t>((WindowSize + filteredRowSize - 1) / filteredRowSize);
+    const size_t stripCount = (height + stripRows - 1) / stripRows;
+
+    std::vector<std::vector<uint8_t>> compressed(stripCount);
+    std::vector<uint32_t> checksums(stripCount);
+    std::vector<size_t> filteredSizes(stripCount);
+    Parallel::forEach(stripCount, [&](size_t strip) {
+        uint32_t firstRow = static_cast<uint32_t>(strip) * stripRows;
+        uint32_t endRow = std::min(height, firstRow + stripRows);
+        uint32_t historyRow = params ? firstRow - std::min(firstRow, windowRows) : firstRow;
+
+        std::vector<uint8_t> filtered(static_cast<size_t>(endRow - historyRow) * filteredRowSize);
+        std::vector<uint8_t> scratch;
+        for (uint32_t y = historyRow; y < endRow; ++y) {
+            const uint8_t* row = rgba + static_cast<size_t>(y) * rowSize;
+            filterRow(row, y > 0 ? row - rowSize : nullptr, rowSize, params != nullptr,
+                filtered.data() + static_cast<size_t>(y - historyRow) * filteredRowSize, scratch);
+        }
+
+        size_t historySize = static_cast<size_t>(firstRow - historyRow) * filteredRowSize;
+        size_t historyUsed = std::min(historySize, WindowSize);
+        const uint8_t* start = filtered.data() + (historySize - historyUsed);
+        compressed[strip] = deflateStrip(start, historyUsed, filtered.size() - (historySize - historyUsed),
+            params, strip + 1 == stripCount);
+        filteredSizes[strip] = filtered.size() - historySize;
+        checksums[strip] = adler32(filtered.data() + historySize, filteredSizes[strip]);
+    });
+
+    uint32_t checksum = checksums[0];
+    for (size_t strip = 1; strip < stripCount; ++strip) {
+        checksum = combineAdler32(checksum, checksums[strip], filteredSizes[strip]);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8-bit RGBA, deflate, adaptive filtering, no interlace
+    writeChunk(file, "IHDR", { { header.data(), header.size() } });
+
+    // zlib header with the level hint, then one IDAT per strip, then the checksum
+    uint8_t zlibHeader[2] = { 0x78, static_cast<uint8_t>(level == Level::Store ? 0x01 :
+        level == Level::Fast ? 0x5E : level == Level::Default ? 0x9C : 0xDA) };
+    std::vector<uint8_t> trailer;
+    appendBigEndian(trailer, checksum);
+    for (size_t strip = 0; strip < stripCount; ++strip) {
+        std::vector<std::pair<const uint8_t*, size_t>> parts;
+        if (strip == 0) parts.push_back({ zlibHeader, sizeof(zlibHeader) });
+        parts.push_back({ compressed[strip].data(), compressed[strip].size() });
+        if (strip + 1 == stripCount) parts.push_back({ trailer.data(), trailer.size() });
+        writeChunk(file, "IDAT", parts);
+    }
+    writeChunk(file, "IEND", {});
+
+    file.close();
+    return !file.fail();
+}
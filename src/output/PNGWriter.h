@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "PNGLevel.h"
+
+// Writes 8-bit RGBA PNGs. Rows are filtered and deflated in horizontal strips on
+// worker threads. Each strip's match search is primed with the 32 KB before it, and
+// strips end on byte-aligned empty stored blocks so they join into one zlib stream.
+class PNGWriter {
+public:
+    using Level = PNGLevel;
+
+    // Accepts "store", "fast", "default" and "best"
+    static bool parseLevel(const std::string& name, Level& outLevel);
+
+    static bool write(const std::string& filename, const uint8_t* rgba, uint32_t width, uint32_t height,
+        Level level = Level::Default);
+};
@@ -63,7 +63,7 @@ std::unique_ptr<Prefab> PrefabLoader::loadFromJson(const std::string& jsonData)
                     }
                 }
 
-                prefab->blocks.push_back(block);
+                prefab->addBlock(std::move(block));
             }
         }
 
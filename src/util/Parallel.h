@@ -0,0 +1,61 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+	inline unsigned int getThreadCount() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Calls fn(index) for every index in [0, count) across worker threads. Indices are
+	// handed out one at a time, so uneven work per index still balances. The first
+	// exception thrown by fn is rethrown on the calling thread.
+	template<typename Fn>
+	void forEach(size_t count, Fn&& fn, unsigned int maxThreads = 0) {
+		unsigned int threadCount = maxThreads == 0 ? getThreadCount() : maxThreads;
+		threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, count));
+
+		if (threadCount <= 1) {
+			for (size_t i = 0; i < count; ++i) {
+				fn(i);
+			}
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::mutex errorMutex;
+
+		auto worker = [&]() {
+			for (size_t i = next++; i < count; i = next++) {
+				try {
+					fn(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(errorMutex);
+					if (!error) error = std::current_exception();
+					next = count;
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (unsigned int t = 1; t < threadCount; ++t) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}